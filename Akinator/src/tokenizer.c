@@ -227,8 +227,7 @@ tokenizer_err_t tokenizer_init(tokenizer_t* t, char const* fname)
 	ASSERT(fname != NULL);
 
 	RF_err_t rt_err = RF_OK;
-	size_t text_size = 0;
-	t->text = read_text2(fname, &text_size, &rt_err);
+	t->text = map_text2(fname, MT_READONLY, &t->text_size, &rt_err);
 
 	switch(rt_err) {
 	case RF_MEMORY:
@@ -247,9 +246,9 @@ tokenizer_err_t tokenizer_init(tokenizer_t* t, char const* fname)
 		break;
 	}
 
-	t->lines = get_text_lines(t->text, text_size, '\n', &t->nlines);
+	t->lines = get_text_lines(t->text, t->text_size, '\n', &t->nlines);
 	if(t->lines == NULL) {
-		free(t->text);
+		unmap_text(t->text, t->text_size);
 		RETURN(tokenizer__set_error(t, TOKENIZER_ERR_MEM));
 	}
 
@@ -267,7 +266,7 @@ void tokenizer_free(tokenizer_t* t)
 	tokenizer_assert(t);
 
 	free(t->lines);
-	free(t->text);
+	unmap_text(t->text, t->text_size);
 $$
 }
 
@@ -275,8 +274,9 @@ token_t tokenizer__mkstr(tokenizer_t* t)
 {$_
 	tokenizer_assert(t);
 
-	char const* pos = memchr(t->lines[t->cline].pfirst + 1, '\"', // TODO
-							 strv_len(&t->lines[t->cline]) - 1);
+	strv_t const rest = strv_init(t->lines[t->cline].pfirst + 1, // TODO
+								  t->lines[t->cline].plast);
+	char const* pos = strv_find(&rest, '\"');
 
 	if(pos == NULL) {
 		tokenizer__set_error(t, TOKENIZER_ERR_EOSTR);
@@ -78,6 +78,7 @@ char const* tokenizer_errstr(tokenizer_err_t err);
 
 typedef struct {
 	char* text;
+	size_t text_size;
 
 	size_t nlines;
 	size_t cline;
@@ -7,7 +7,7 @@
 
 
 void signal_sigsegv(int _) {
-	stacktrace_print(stderr);
+	stacktrace_print_all(stderr);
 	abort();
 }
 
@@ -26,6 +26,7 @@ char const* tokenizer_errstr(tokenizer_err_t errc)
 typedef struct {
 	tokenizer_err_t err;
 	char* text;
+	size_t text_size;
 	strv_t* lines;
 	size_t nlines;
 	size_t curline;
@@ -43,7 +44,7 @@ static void tokenizer__remove_comments()
 	for(strv_t* line = tokenizer.lines; line < tokenizer.lines + tokenizer.nlines;
 		++line)
 	{
-		char* pos = memchr(strv_begin(line), ';', strv_len(line));
+		char* pos = (char*)strv_find(line, ';');
 		if(pos != NULL) {
 			line->plast = pos;
 			*(char*)line->plast = '\0'; // <- a bit shitty...
@@ -57,8 +58,7 @@ tokenizer_err_t const tokenizer_init(FILE* file)
 	stream_assert(file);
 
 	RT_err_t rt_errc;
-	size_t text_size;
-	tokenizer.text = read_text(file, &text_size, &rt_errc);
+	tokenizer.text = map_text(file, MT_PRIVATE, &tokenizer.text_size, &rt_errc);
 	switch(rt_errc) {
 	case RT_MEMORY:
 		RETURN(tokenizer__set_error(TOKENIZER_ERR_MEM));
@@ -70,9 +70,10 @@ tokenizer_err_t const tokenizer_init(FILE* file)
 		break;
 	}
 
-	tokenizer.lines = get_text_lines(tokenizer.text, text_size, '\n', &tokenizer.nlines);
+	tokenizer.lines = get_text_lines(tokenizer.text, tokenizer.text_size, '\n', 
+									 &tokenizer.nlines);
 	if(tokenizer.lines == NULL) {
-		free(tokenizer.text);
+		unmap_text(tokenizer.text, tokenizer.text_size);
 		RETURN(tokenizer__set_error(TOKENIZER_ERR_MEM));
 	}
 
@@ -90,7 +91,7 @@ void tokenizer_free()
 	tokenizer_assert();
 
 	free(tokenizer.lines);
-	free(tokenizer.text);
+	unmap_text(tokenizer.text, tokenizer.text_size);
 $$
 }
 
@@ -99,26 +100,36 @@ tokenizer_err_t const tokenizer_nextline(size_t max_args, char* args[], size_t*
 	ASSERT(args != NULL);
 	ASSERT(num != NULL);
 
-	char const* SPACES = " \t";
+	static strv_cset_t SPACES;
+	static int spaces_ready = 0;
+	if(!spaces_ready) {
+		strv_cset_init(&SPACES, " \t");
+		spaces_ready = 1;
+	}
 
 	if(tokenizer.curline == tokenizer.nlines) {
 		RETURN(tokenizer__set_error(TOKENIZER_ERR_EOF));
 	}
 
-	strv_t* line = tokenizer.lines + tokenizer.curline;
+	strv_t line = tokenizer.lines[tokenizer.curline];
 
 	size_t nargs = 0;
-	char* pos = strtok((char*)line->pfirst, SPACES);
+	strv_t tok = strv_ntokc(&line, &SPACES);
 
-	while(pos != NULL && nargs < max_args) {
-		args[nargs++] = pos;
-		pos = strtok(NULL, SPACES);
+	while(!strv_empty(&tok) && nargs < max_args) {
+		// the text is a private mapping, so tokens are terminated in place
+		if(tok.plast < line.plast) {
+			*(char*)tok.plast = '\0';
+			++line.pfirst;
+		}
+		args[nargs++] = (char*)tok.pfirst;
+		tok = strv_ntokc(&line, &SPACES);
 	}
 
 	*num = nargs;
 	++tokenizer.curline;
 
-	if(pos != NULL) {
+	if(!strv_empty(&tok)) {
 		RETURN(tokenizer__set_error(TOKENIZER_ERR_OVERFLOW));
 	}
 	
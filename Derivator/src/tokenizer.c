@@ -227,8 +227,7 @@ tokenizer_err_t const tokenizer_init(tokenizer_t* tokenizer, char const* filenam
 	ASSERT(filename != NULL);
 
 	RF_err_t rt_err = RF_OK;
-	size_t text_size = 0;
-	tokenizer->text = read_text2(filename, &text_size, &rt_err);
+	tokenizer->text = map_text2(filename, MT_READONLY, &tokenizer->text_size, &rt_err);
 
 	switch(rt_err) {
 	case RF_MEMORY:
@@ -247,10 +246,10 @@ tokenizer_err_t const tokenizer_init(tokenizer_t* tokenizer, char const* filenam
 		break;
 	}
 
-	tokenizer->lines = get_text_lines(tokenizer->text, text_size, '\n', 
+	tokenizer->lines = get_text_lines(tokenizer->text, tokenizer->text_size, '\n', 
 									  &tokenizer->nlines);
 	if(tokenizer->lines == NULL) {
-		free(tokenizer->text);
+		unmap_text(tokenizer->text, tokenizer->text_size);
 		RETURN(tokenizer__set_error(tokenizer, TOKENIZER_ERR_MEM));
 	}
 
@@ -268,7 +267,7 @@ void tokenizer_free(tokenizer_t* tokenizer)
 	tokenizer_assert(tokenizer);
 
 	free(tokenizer->lines);
-	free(tokenizer->text);
+	unmap_text(tokenizer->text, tokenizer->text_size);
 $$
 }
 
@@ -74,6 +74,7 @@ ENUMEX_HEADER(tokenizer_err,
 
 typedef struct {
 	char* text;
+	size_t text_size;
 	strv_t* lines;
 	size_t cline;
 	size_t nlines;
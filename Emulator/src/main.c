@@ -25,6 +25,7 @@
 #include <ttrack/dbg.h>
 #include <ttrack/binbuf.h>
 #include <ttrack/comp.h>
+#include <ttrack/log.h>
 
 #define EPS 1e-7
 
@@ -34,6 +35,7 @@ double regs[REGCNT];
 stack_double_t stack;
 stack_size_t_t callstack;
 double mem[MEM_SIZE];
+logger_t cpu_log;
 
 int const cpu_init(char const* binfile)
 {$_
@@ -110,6 +112,8 @@ void cpu_execute()
 	regid_t id;
 
 	while(binbuf_read_value(opcode_t, opcode) != BINBUF_ERR_RANGE) {
+		LOGGER_LOG_DEBUG(&cpu_log, "%zu: opcode %hhu, stack size %zu\n", 
+						 binbuf_pos() - sizeof(opcode_t), opcode, stack.size);
 		switch(opcode) {
 		case OPCODE_HLT:
 			STACKTRACE_POP
@@ -242,7 +246,7 @@ void cpu_execute()
 			BINBUF_CHECK(binbuf_read_value(offset_t, pos));
 			STACK_CHECK(stack_pop(double, &stack, &op1));
 			STACK_CHECK(stack_pop(double, &stack, &op2));
-			fprintf(stderr, "%lf > %lf?\n", op1, op2);
+			LOGGER_LOG_DEBUG(&cpu_log, "%lf > %lf?\n", op1, op2);
 			if(op1 > op2) {
 				BINBUF_CHECK(binbuf_seek((size_t)pos));
 			}
@@ -292,11 +296,16 @@ int main(int argc, char* argv[])
 		RETURN(EXIT_FAILURE);
 	}
 
+	logger_init(&cpu_log, stderr, getenv("EMULATOR_DEBUG") != NULL ? LOGGER_DEBUG 
+															 : LOGGER_INFO, 0);
+
 	if(!cpu_init(argv[1])) {
+		logger_free(&cpu_log);
 		RETURN(EXIT_FAILURE);
 	}
 
 	cpu_execute();
 	cpu_free();
+	logger_free(&cpu_log);
 
 }
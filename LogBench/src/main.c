@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <ttrack/log.h>
+
+/*
+ * Measures logger throughput: every thread writes nrecords records with
+ * logger_printf0(), the time is taken from the start of the first thread to
+ * the moment all records reached the stream (logger_flush()).
+ */
+
+typedef struct {
+	logger_t* logger;
+	int id;
+	int nrecords;
+} worker_t;
+
+typedef enum {
+	MODE_SYNC = 0,
+	MODE_ASYNC_BLOCK,
+	MODE_ASYNC_COUNT,
+	MODE_BINARY_SYNC,
+	MODE_BINARY_ASYNC,
+
+	NMODES
+} bench_mode_t;
+
+static char const* const MODESTR[NMODES] = {
+	"sync",
+	"async block",
+	"async count",
+	"binary sync",
+	"binary async"
+};
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void* worker_main(void* data)
+{
+	worker_t* const worker = (worker_t*)data;
+
+	for(int i = 0; i < worker->nrecords; ++i) {
+		logger_printf0(worker->logger, LOGGER_INFO, 
+					   "thread %i record %i value %lf\n", worker->id, i, i * 0.5);
+	}
+	return NULL;
+}
+
+static int run(bench_mode_t mode, int nthreads, int nrecords, FILE* stream)
+{
+	logger_t logger;
+	logger_err_t err = LOGGER_ERR_OK;
+
+	switch(mode) {
+	case MODE_SYNC:
+		err = logger_init(&logger, stream, LOGGER_DEBUG, 0);
+		break;
+	case MODE_ASYNC_BLOCK:
+		err = logger_init_async(&logger, stream, LOGGER_DEBUG, 0, 4096, 
+								LOGGER_OVERFLOW_BLOCK);
+		break;
+	case MODE_ASYNC_COUNT:
+		err = logger_init_async(&logger, stream, LOGGER_DEBUG, 0, 4096, 
+								LOGGER_OVERFLOW_COUNT);
+		break;
+	case MODE_BINARY_SYNC:
+		err = logger_init(&logger, stream, LOGGER_DEBUG, 0);
+		if(err == LOGGER_ERR_OK) {
+			err = logger_set_binary(&logger);
+		}
+		break;
+	case MODE_BINARY_ASYNC:
+		err = logger_init_async(&logger, stream, LOGGER_DEBUG, 0, 4096, 
+								LOGGER_OVERFLOW_BLOCK);
+		if(err == LOGGER_ERR_OK) {
+			err = logger_set_binary(&logger);
+		}
+		break;
+	default:
+		return 0;
+	}
+	if(err != LOGGER_ERR_OK) {
+		fprintf(stderr, "logger initialization failed: %s\n", logger_errorstr(err));
+		return 0;
+	}
+
+	pthread_t* threads = (pthread_t*)calloc(nthreads, sizeof(pthread_t));
+	worker_t* workers = (worker_t*)calloc(nthreads, sizeof(worker_t));
+	if(threads == NULL || workers == NULL) {
+		free(threads);
+		free(workers);
+		logger_free(&logger);
+		return 0;
+	}
+
+	double const start = now();
+	for(int i = 0; i < nthreads; ++i) {
+		workers[i].logger = &logger;
+		workers[i].id = i;
+		workers[i].nrecords = nrecords;
+		pthread_create(&threads[i], NULL, worker_main, &workers[i]);
+	}
+	for(int i = 0; i < nthreads; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+	double const producers = now() - start;
+	logger_flush(&logger);
+	double const total = now() - start;
+
+	size_t const ndropped = logger_get_ndropped(&logger);
+	double const nall = (double)nthreads * nrecords;
+
+	printf("%-12s %8i %16.0f %16.0f %10zu\n", MODESTR[mode], nthreads,
+		   nall / producers, (nall - ndropped) / total, ndropped);
+
+	free(threads);
+	free(workers);
+	logger_free(&logger);
+	return 1;
+}
+
+int main(int argc, char* argv[])
+{
+	int const max_threads = argc > 1 ? atoi(argv[1]) : 8;
+	int const nrecords = argc > 2 ? atoi(argv[2]) : 200000;
+	char const* const filename = argc > 3 ? argv[3] : "/dev/null";
+
+	if(max_threads <= 0 || nrecords <= 0) {
+		fprintf(stderr, "usage: logbench [max threads] [records per thread] [output file]\n");
+		return EXIT_FAILURE;
+	}
+
+	FILE* stream = fopen(filename, "w");
+	if(stream == NULL) {
+		fprintf(stderr, "failed to open \'%s\'\n", filename);
+		return EXIT_FAILURE;
+	}
+
+	printf("%-12s %8s %16s %16s %10s\n", "mode", "threads", "calls/s", "written/s", 
+		   "dropped");
+	for(int mode = 0; mode < NMODES; ++mode) {
+		for(int nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+			if(!run((bench_mode_t)mode, nthreads, nrecords, stream)) {
+				fclose(stream);
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	fclose(stream);
+	return EXIT_SUCCESS;
+}
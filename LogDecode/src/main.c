@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <ttrack/log.h>
+
+/*
+ * Turns a binary log written with logger_set_binary() into the text log.
+ */
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2 || argc > 3) {
+		fprintf(stderr, "usage: logdecode <input> [output]\n");
+		return EXIT_FAILURE;
+	}
+
+	FILE* in = fopen(argv[1], "rb");
+	if(in == NULL) {
+		fprintf(stderr, "failed to open \'%s\'\n", argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	FILE* out = argc > 2 ? fopen(argv[2], "w") : stdout;
+	if(out == NULL) {
+		fprintf(stderr, "failed to open \'%s\'\n", argv[2]);
+		fclose(in);
+		return EXIT_FAILURE;
+	}
+
+	logger_err_t const err = logger_decode(in, out);
+	if(err != LOGGER_ERR_OK) {
+		fprintf(stderr, "failed to decode \'%s\': %s\n", argv[1], logger_errorstr(err));
+	}
+
+	fclose(in);
+	if(out != stdout) {
+		fclose(out);
+	}
+	return err == LOGGER_ERR_OK ? EXIT_SUCCESS : EXIT_FAILURE;
+}
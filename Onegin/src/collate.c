@@ -0,0 +1,328 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <ttrack/dbg.h>
+
+#include "collate.h"
+
+#if defined __SSE2__
+#	include <emmintrin.h>
+#	define COLLATE__SSE2
+#endif
+
+/*
+ * UTF-8 sequence length by its first byte, 0 if the byte can't start a sequence
+ * (continuation bytes, overlong C0 and C1, code points above U+10FFFF).
+ */
+static unsigned char const COLLATE__SEQLEN[256] = {
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 00 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 10 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 20 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 30 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 40 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 50 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 60 */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, /* 70 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 80 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 90 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* A0 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* B0 */
+	0, 0, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, /* C0 */
+	2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, /* D0 */
+	3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, /* E0 */
+	4, 4, 4, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* F0 */
+};
+
+/// Code points below this one are looked up in the folding table.
+#define COLLATE__NFOLD 0x500
+
+/*
+ * Folded (lowercase) code point of every letter below COLLATE__NFOLD, 0 for 
+ * everything else.
+ */
+static uint16_t collate__fold[COLLATE__NFOLD];
+static pthread_once_t collate__fold_once = PTHREAD_ONCE_INIT;
+
+/// Marks code points [first, last] as letters that are folded by adding shift.
+static void collate__letters(unsigned const first, unsigned const last, unsigned const shift)
+{
+	for(unsigned cp = first; cp <= last; ++cp) {
+		collate__fold[cp] = (uint16_t)(cp + shift);
+	}
+}
+
+/// Marks code points [first, last] as pairs of an uppercase letter and the next
+/// lowercase one, the first of pairs is upper.
+static void collate__pairs(unsigned const upper, unsigned const last)
+{
+	for(unsigned cp = upper; cp <= last; ++cp) {
+		collate__fold[cp] = (uint16_t)((cp - upper) % 2 == 0 ? cp + 1 : cp);
+	}
+}
+
+static void collate__init_fold()
+{
+	// Basic Latin
+	collate__letters('A', 'Z', 'a' - 'A');
+	collate__letters('a', 'z', 0);
+
+	// Latin-1 Supplement, but the multiplication and division signs
+	collate__letters(0x00C0, 0x00DE, 0x20);
+	collate__letters(0x00DF, 0x00FF, 0);
+	collate__fold[0x00D7] = collate__fold[0x00F7] = 0;
+
+	// Latin Extended-A
+	collate__pairs(0x0100, 0x012F);
+	collate__fold[0x0130] = 'i';
+	collate__fold[0x0131] = 0x0131;
+	collate__pairs(0x0132, 0x0137);
+	collate__fold[0x0138] = 0x0138;
+	collate__pairs(0x0139, 0x0148);
+	collate__fold[0x0149] = 0x0149;
+	collate__pairs(0x014A, 0x0177);
+	collate__fold[0x0178] = 0x00FF;
+	collate__pairs(0x0179, 0x017E);
+	collate__fold[0x017F] = 's';
+
+	// Cyrillic, but historic signs and combining marks 0482-0489
+	collate__letters(0x0400, 0x040F, 0x50);
+	collate__letters(0x0410, 0x042F, 0x20);
+	collate__letters(0x0430, 0x045F, 0);
+	collate__fold[0x0401] = collate__fold[0x0451] = 0x0435;	// ё sorts as е
+	collate__pairs(0x0460, 0x0481);
+	collate__pairs(0x048A, 0x04BF);
+	collate__fold[0x04C0] = 0x04CF;
+	collate__pairs(0x04C1, 0x04CE);
+	collate__fold[0x04CF] = 0x04CF;
+	collate__pairs(0x04D0, 0x04FF);
+}
+
+/// Decodes the character at ch and returns its folded code point or 0 if it is not a
+/// letter. *plen gets the number of bytes to skip: invalid bytes are skipped one by one.
+static inline unsigned collate__decode(unsigned char const* const ch, 
+									   unsigned char const* const end, size_t* const plen)
+{
+	size_t const len = COLLATE__SEQLEN[*ch];
+
+	*plen = 1;
+	if(len == 1) {
+		return collate__fold[*ch];
+	}
+	if(len == 0 || (size_t)(end - ch) < len) {
+		return 0;
+	}
+	for(size_t i = 1; i < len; ++i) {
+		if((ch[i] & 0xC0) != 0x80)
+			return 0;
+	}
+
+	*plen = len;
+	if(len == 2) {
+		// all the letters we fold are 2 bytes long
+		unsigned const cp = (unsigned)(ch[0] & 0x1F) << 6 | (ch[1] & 0x3F);
+		return cp < COLLATE__NFOLD ? collate__fold[cp] : 0;
+	}
+	return 0;
+}
+
+/// Writes the folded letter as UTF-8, returns the end of it.
+static inline char* collate__encode(char* out, unsigned const cp)
+{
+	if(cp < 0x80) {
+		*out++ = (char)cp;
+	} else {
+		*out++ = (char)(0xC0 | cp >> 6);
+		*out++ = (char)(0x80 | (cp & 0x3F));
+	}
+	return out;
+}
+
+/*
+ * Writes the forward key of the line to out and returns its end. Blocks of ASCII
+ * characters are looked up without decoding and without branches: every byte is
+ * written, but out moves only past letters. So a byte after the key may be
+ * overwritten, it is within the line size anyway.
+ */
+static char* collate__key(char* out, char const* const first, char const* const last)
+{
+	unsigned char const* ch = (unsigned char const*)first;
+	unsigned char const* const end = (unsigned char const*)last;
+
+	while(ch < end) {
+		size_t nascii = 0;
+#ifdef COLLATE__SSE2
+		if(end - ch >= 16) {
+			unsigned const mask = (unsigned)_mm_movemask_epi8(
+				_mm_loadu_si128((__m128i const*)ch));
+			nascii = mask != 0 ? (size_t)__builtin_ctz(mask) : 16;
+		}
+#endif /* COLLATE__SSE2 */
+
+		for(size_t i = 0; i < nascii; ++i) {
+			char const letter = (char)collate__fold[ch[i]];
+			*out = letter;
+			out += letter != 0;
+		}
+		ch += nascii;
+
+		if(ch < end && nascii < 16) {
+			size_t len = 0;
+			unsigned const cp = collate__decode(ch, end, &len);
+			if(cp != 0)
+				out = collate__encode(out, cp);
+			ch += len;
+		}
+	}
+	return out;
+}
+
+/*
+ * Reverses the key by characters: bytes of every character stay in their order.
+ * The key may be reversed in place.
+ */
+static void collate__reverse(char* const out, char const* const key, size_t const len)
+{
+	if(out != key)
+		memcpy(out, key, len);
+	for(size_t lo = 0, hi = len; lo + 1 < hi; ++lo, --hi) {
+		char const tmp = out[lo];
+		out[lo] = out[hi - 1];
+		out[hi - 1] = tmp;
+	}
+
+	// continuation bytes now precede their first byte
+	for(size_t i = 0; i < len; ) {
+		if(((unsigned char)out[i] & 0xC0) != 0x80) {
+			++i;
+			continue;
+		}
+
+		size_t j = i;
+		while(j + 1 < len && ((unsigned char)out[j] & 0xC0) == 0x80)
+			++j;
+		for(size_t lo = i, hi = j; lo < hi; ++lo, --hi) {
+			char const tmp = out[lo];
+			out[lo] = out[hi];
+			out[hi] = tmp;
+		}
+		i = j + 1;
+	}
+}
+
+unsigned const collate_letter(char const** const pch, char const* const end)
+{$_
+	ASSERT(pch != NULL);
+	ASSERT(*pch < end);
+
+	pthread_once(&collate__fold_once, collate__init_fold);
+
+	size_t len = 0;
+	unsigned const cp = collate__decode((unsigned char const*)*pch, 
+										(unsigned char const*)end, &len);
+	*pch += len;
+	RETURN(cp);
+}
+
+int const keyarena_init(keyarena_t* const keys, strv_t const* const lines, 
+						size_t const nlines, int const orders)
+{$_
+	ASSERT(keys != NULL);
+	ASSERT(lines != NULL);
+	ASSERT((orders & (KEYS_FORWARD | KEYS_REVERSE)) != 0);
+
+	size_t const ncopies = (orders & KEYS_FORWARD ? 1 : 0) + (orders & KEYS_REVERSE ? 1 : 0);
+
+	// keys are never longer than lines
+	size_t capacity = 0;
+	for(size_t i = 0; i < nlines; ++i) {
+		capacity += (size_t)(lines[i].plast - lines[i].pfirst);
+	}
+
+	keys->data = (char*)malloc(ncopies * capacity + 1);
+	keys->offsets = (size_t*)malloc((ncopies * nlines + 1) * sizeof(size_t));
+	keys->nkeys = ncopies * nlines;
+	keys->nlines = nlines;
+	if(keys->data == NULL || keys->offsets == NULL) {
+		keyarena_free(keys);
+		RETURN(0);
+	}
+
+	pthread_once(&collate__fold_once, collate__init_fold);
+
+	char* out = keys->data;
+	size_t* offset = keys->offsets;
+	if(orders & KEYS_FORWARD) {
+		for(size_t i = 0; i < nlines; ++i) {
+			*offset++ = (size_t)(out - keys->data);
+			out = collate__key(out, lines[i].pfirst, lines[i].plast);
+		}
+	}
+
+	if(orders & KEYS_REVERSE) {
+		size_t const end = (size_t)(out - keys->data);
+		for(size_t i = 0; i < nlines; ++i) {
+			*offset++ = (size_t)(out - keys->data);
+
+			if(orders & KEYS_FORWARD) {
+				// the forward keys are already normalized, just turn them over
+				size_t const first = keys->offsets[i];
+				size_t const last = i + 1 < nlines ? keys->offsets[i + 1] : end;
+				collate__reverse(out, keys->data + first, last - first);
+				out += last - first;
+			} else {
+				char* const key = out;
+				out = collate__key(out, lines[i].pfirst, lines[i].plast);
+				collate__reverse(key, key, (size_t)(out - key));
+			}
+		}
+	}
+	*offset = (size_t)(out - keys->data);
+
+	RETURN(1);
+}
+
+void keyarena_free(keyarena_t* const keys)
+{$_
+	ASSERT(keys != NULL);
+
+	free(keys->data);
+	free(keys->offsets);
+	keys->data = NULL;
+	keys->offsets = NULL;
+	keys->nkeys = 0;
+	keys->nlines = 0;
+$$
+}
+
+sortrec_t* const sortrec_make(keyarena_t const* const keys, size_t const first,
+							  size_t const nrecs)
+{$_
+	ASSERT(keys != NULL);
+	ASSERT(first + nrecs <= keys->nkeys);
+
+	if(first + nrecs > UINT32_MAX) {
+		RETURN(NULL);
+	}
+
+	sortrec_t* const recs = (sortrec_t*)malloc(nrecs * sizeof(sortrec_t) + 1);
+	if(recs == NULL) {
+		RETURN(NULL);
+	}
+
+	for(size_t i = 0; i < nrecs; ++i) {
+		size_t const len = keyarena_len(keys, first + i);
+		char const* const key = keyarena_key(keys, first + i);
+
+		uint64_t prefix = 0;
+		for(size_t j = 0; j < SORTREC_PREFIX_SIZE; ++j) {
+			prefix = prefix << 8 | (j < len ? (unsigned char)key[j] : 0);
+		}
+
+		recs[i].prefix = prefix;
+		recs[i].len = len > UINT32_MAX ? UINT32_MAX : (uint32_t)len;
+		recs[i].index = (uint32_t)(first + i);
+	}
+
+	RETURN(recs);
+}
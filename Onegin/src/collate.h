@@ -0,0 +1,145 @@
+#ifndef ONEGIN_COLLATE_H
+#define ONEGIN_COLLATE_H
+
+#ifdef __GNUC__
+#	pragma GCC diagnostic ignored "-Wignored-qualifiers"
+#endif /* __GNUC__ */
+
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#include <ttrack/strv.h>
+
+/// Kinds of keys to build.
+typedef enum {
+	KEYS_FORWARD = 1,	///< letters in the line order
+	KEYS_REVERSE = 2,	///< letters from the end of the line
+} keyorder_t;
+
+/**
+ * \brief Normalized collation keys of all lines, one after another.
+ *
+ * The key of a line consists of its letters only, lowercased, so two lines
+ * compare like Comparator() compares them. The text is UTF-8: letters are Latin
+ * (ASCII, Latin-1 and Latin Extended-A) and Cyrillic ones, folded to lowercase and
+ * written as UTF-8, so keys compare by code points. Other characters and invalid
+ * bytes are skipped. The reversed key holds the same letters from the end, so
+ * sorting reversed keys forward sorts lines from the end.
+ *
+ * Keys are numbered: forward keys of lines 0..nlines-1 go first (if built), then
+ * reversed ones. The key k is data[offsets[k]] .. data[offsets[k + 1]].
+ */
+typedef struct {
+	char* data;
+	size_t* offsets;	///< nkeys + 1 offsets
+	size_t nkeys;
+	size_t nlines;
+} keyarena_t;
+
+/**
+ * \brief Builds keys of the lines.
+ *
+ * \param[in] orders KEYS_FORWARD, KEYS_REVERSE or both.
+ * \return 1 in case of success, 0 if malloc() failed.
+ */
+int const keyarena_init(keyarena_t* const keys, strv_t const* const lines, 
+						size_t const nlines, int const orders);
+void keyarena_free(keyarena_t* const keys);
+
+/**
+ * \brief Decodes the UTF-8 character at *pch and moves *pch past it. The way
+ * keyarena_init() reads lines.
+ *
+ * \return folded code point of the letter or 0 if the character is not a letter.
+ */
+unsigned const collate_letter(char const** const pch, char const* const end);
+
+/// Number of the first key of the order. Valid only if the keys of the order were built.
+static inline size_t const keyarena_first(keyarena_t const* const keys, 
+										  keyorder_t const order)
+{
+	return order == KEYS_REVERSE ? keys->nkeys - keys->nlines : 0;
+}
+
+/// Number of the line the key k belongs to.
+static inline size_t const keyarena_line(keyarena_t const* const keys, size_t const k)
+{
+	return k < keys->nlines ? k : k - keys->nlines;
+}
+
+/// Length of the key k.
+static inline size_t const keyarena_len(keyarena_t const* const keys, size_t const k)
+{
+	return keys->offsets[k + 1] - keys->offsets[k];
+}
+
+/// Key k.
+static inline char const* keyarena_key(keyarena_t const* const keys, size_t const k)
+{
+	return keys->data + keys->offsets[k];
+}
+
+/// Number of key bytes stored in the sort record itself.
+#define SORTREC_PREFIX_SIZE 8
+
+/**
+ * \brief Element of the sorted array.
+ *
+ * The first SORTREC_PREFIX_SIZE key bytes are packed big-endian into prefix, so
+ * most comparisons are a single integer comparison.
+ */
+typedef struct {
+	uint64_t prefix;
+	uint32_t len;	///< key length
+	uint32_t index;	///< key number, also breaks ties
+} sortrec_t;
+
+/**
+ * \brief Makes records of nrecs keys starting from the key first.
+ *
+ * \return the records or NULL if malloc() failed or there are too many keys.
+ *
+ * \warning You have to call free() for the return value.
+ */
+sortrec_t* const sortrec_make(keyarena_t const* const keys, size_t const first,
+							  size_t const nrecs);
+
+/**
+ * \brief Compares records: by key, then by key number. Lines with equal keys
+ * stay in the original order, so every sort gives the same result.
+ */
+static inline int const sortrec_cmp(sortrec_t const* const r1, sortrec_t const* const r2,
+									keyarena_t const* const keys)
+{
+	if(r1->prefix != r2->prefix) {
+		return r1->prefix < r2->prefix ? -1 : 1;
+	}
+
+	// a key shorter than the prefix is padded with zeros, which keys don't contain
+	if(r1->len > SORTREC_PREFIX_SIZE && r2->len > SORTREC_PREFIX_SIZE) {
+		size_t const len = (r1->len < r2->len ? r1->len : r2->len) - SORTREC_PREFIX_SIZE;
+		int const res = memcmp(keyarena_key(keys, r1->index) + SORTREC_PREFIX_SIZE, 
+							   keyarena_key(keys, r2->index) + SORTREC_PREFIX_SIZE, len);
+		if(res != 0) {
+			return res;
+		}
+	}
+
+	if(r1->len != r2->len) {
+		return r1->len < r2->len ? -1 : 1;
+	}
+	return (r1->index > r2->index) - (r1->index < r2->index);
+}
+
+/// Whether the keys of the records are equal.
+static inline int const sortrec_keyeq(sortrec_t const* const r1, sortrec_t const* const r2,
+									  keyarena_t const* const keys)
+{
+	return r1->prefix == r2->prefix && r1->len == r2->len && 
+		   (r1->len <= SORTREC_PREFIX_SIZE || 
+			memcmp(keyarena_key(keys, r1->index) + SORTREC_PREFIX_SIZE, 
+				   keyarena_key(keys, r2->index) + SORTREC_PREFIX_SIZE,
+				   r1->len - SORTREC_PREFIX_SIZE) == 0);
+}
+
+#endif /* ONEGIN_COLLATE_H */
@@ -0,0 +1,548 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include <ttrack/dbg.h>
+#include <ttrack/text.h>
+
+#include "collate.h"
+#include "sort.h"
+#include "extsort.h"
+
+/// Buffer size of every temporary file.
+#define EXTSORT__BUFSIZE (1 << 16)
+
+static char const* const EXTSORT__ERRSTR[] = {
+	"no errors",
+	"out of memory",
+	"failed to read the input",
+	"failed to write the output",
+	"failed to use a temporary file",
+};
+
+char const* const extsort_errstr(extsort_err_t const err)
+{$_
+	ASSERT(0 <= err && err < EXTSORT_NERRORS);
+	RETURN(EXTSORT__ERRSTR[err]);
+}
+
+/*
+ * Run file is a sequence of records: the header, the key and the line.
+ */
+typedef struct {
+	uint64_t line;	///< line number in the input
+	uint64_t count;	///< number of lines collapsed into this one
+	uint32_t keylen;
+	uint32_t linelen;
+} extsort__header_t;
+
+typedef struct {
+	FILE** files;
+	size_t nfiles;
+	size_t capacity;
+} extsort__runs_t;
+
+static extsort_err_t extsort__runs_add(extsort__runs_t* const runs, FILE* const file)
+{
+	if(runs->nfiles == runs->capacity) {
+		size_t const capacity = runs->capacity > 0 ? 2 * runs->capacity : 16;
+		FILE** const files = (FILE**)realloc(runs->files, capacity * sizeof(FILE*));
+		if(files == NULL) {
+			fclose(file);
+			return EXTSORT_ERR_MEMORY;
+		}
+		runs->files = files;
+		runs->capacity = capacity;
+	}
+
+	runs->files[runs->nfiles++] = file;
+	return EXTSORT_ERR_OK;
+}
+
+static void extsort__runs_free(extsort__runs_t* const runs)
+{
+	for(size_t i = 0; i < runs->nfiles; ++i) {
+		fclose(runs->files[i]);
+	}
+	free(runs->files);
+
+	runs->files = NULL;
+	runs->nfiles = 0;
+	runs->capacity = 0;
+}
+
+static FILE* extsort__tmpfile()
+{
+	FILE* const file = tmpfile();
+	if(file != NULL) {
+		setvbuf(file, NULL, _IOFBF, EXTSORT__BUFSIZE);
+	}
+	return file;
+}
+
+// finishes writing the run and rewinds it to be read
+static extsort_err_t extsort__run_done(FILE* const file)
+{
+	if(fflush(file) != 0 || ferror(file)) {
+		return EXTSORT_ERR_TMPFILE;
+	}
+	rewind(file);
+	return EXTSORT_ERR_OK;
+}
+
+static int extsort__write_record(FILE* const file, extsort__header_t const* const header,
+								 char const* const key, char const* const line)
+{
+	return fwrite(header, sizeof(*header), 1, file) == 1 &&
+		   fwrite(key, 1, header->keylen, file) == header->keylen &&
+		   fwrite(line, 1, header->linelen, file) == header->linelen;
+}
+
+// sorts the chunk of lines by one order of keys and writes the query as a run
+static extsort_err_t extsort__write_run(strv_t const* const lines, keyarena_t const* const keys,
+										keyorder_t const order, uint64_t const first_line,
+										extsort_params_t const* const params, 
+										extsort__runs_t* const runs)
+{
+	size_t nrecs = keys->nlines;
+	sortrec_t* const recs = sortrec_make(keys, keyarena_first(keys, order), nrecs);
+	size_t* const counts = params->query.unique != UNIQUE_NONE ? 
+						   (size_t*)malloc(nrecs * sizeof(size_t) + 1) : NULL;
+	if(recs == NULL || (params->query.unique != UNIQUE_NONE && counts == NULL) ||
+	   !sortrec_query(recs, &nrecs, keys, order, &params->query, params->radix, 
+					  params->nthreads, counts)) {
+		free(recs);
+		free(counts);
+		return EXTSORT_ERR_MEMORY;
+	}
+
+	FILE* const file = extsort__tmpfile();
+	if(file == NULL) {
+		free(recs);
+		free(counts);
+		return EXTSORT_ERR_TMPFILE;
+	}
+
+	extsort_err_t err = EXTSORT_ERR_OK;
+	for(size_t i = 0; i < nrecs; ++i) {
+		size_t const line = keyarena_line(keys, recs[i].index);
+		extsort__header_t const header = { 
+			first_line + line, 
+			counts != NULL ? counts[i] : 1,
+			(uint32_t)keyarena_len(keys, recs[i].index),
+			(uint32_t)(lines[line].plast - lines[line].pfirst),
+		};
+
+		if(!extsort__write_record(file, &header, keyarena_key(keys, recs[i].index), 
+								  lines[line].pfirst)) {
+			err = EXTSORT_ERR_TMPFILE;
+			break;
+		}
+	}
+	free(recs);
+	free(counts);
+
+	if(err == EXTSORT_ERR_OK) {
+		err = extsort__run_done(file);
+	}
+	if(err != EXTSORT_ERR_OK) {
+		fclose(file);
+		return err;
+	}
+	return extsort__runs_add(runs, file);
+}
+
+// memory taken by a chunk besides its text
+static size_t extsort__cost(size_t const size, size_t const nlines, size_t const norders)
+{
+	// keys, lines, key offsets, records of one order and the sort buffer
+	return norders * size + nlines * (sizeof(strv_t) + norders * sizeof(size_t) + 
+									  2 * sizeof(sortrec_t));
+}
+
+/*
+ * Length of the longest prefix of whole lines (separators included) that fits into
+ * the budget, at least one line. 0 if there is no separator.
+ */
+static size_t extsort__cut(char const* const text, size_t const size, 
+						   size_t const budget, size_t const norders)
+{
+	size_t cut = 0;
+	size_t nlines = 0;
+	for(;;) {
+		char const* const sep = (char const*)memchr(text + cut, '\n', size - cut);
+		if(sep == NULL) {
+			return cut;
+		}
+
+		size_t const next = (size_t)(sep - text) + 1;
+		if(cut != 0 && extsort__cost(next, ++nlines, norders) > budget) {
+			return cut;
+		}
+		cut = next;
+	}
+}
+
+// sorts the chunk, the text is split in place
+static extsort_err_t extsort__sort_chunk(char* const text, size_t const size, 
+										 uint64_t* const pline, 
+										 extsort_params_t const* const params,
+										 extsort__runs_t* const fruns, 
+										 extsort__runs_t* const rruns)
+{
+	size_t nlines = 0;
+	strv_t* const lines = get_text_lines(text, size, '\n', &nlines);
+	if(lines == NULL) {
+		return EXTSORT_ERR_MEMORY;
+	}
+
+	keyarena_t keys = {};
+	int const orders = (params->forward != NULL ? KEYS_FORWARD : 0) |
+					   (params->reverse != NULL ? KEYS_REVERSE : 0);
+	if(!keyarena_init(&keys, lines, nlines, orders)) {
+		free(lines);
+		return EXTSORT_ERR_MEMORY;
+	}
+
+	extsort_err_t err = EXTSORT_ERR_OK;
+	if(params->forward != NULL) {
+		err = extsort__write_run(lines, &keys, KEYS_FORWARD, *pline, params, fruns);
+	}
+	if(err == EXTSORT_ERR_OK && params->reverse != NULL) {
+		err = extsort__write_run(lines, &keys, KEYS_REVERSE, *pline, params, rruns);
+	}
+
+	*pline += nlines;
+	keyarena_free(&keys);
+	free(lines);
+	return err;
+}
+
+typedef struct {
+	FILE* file;
+	extsort__header_t header;
+	char* data;		///< key, then line
+	size_t capacity;
+	int done;
+} extsort__reader_t;
+
+static int extsort__keyeq(extsort__reader_t const* const a, extsort__reader_t const* const b)
+{
+	return a->header.keylen == b->header.keylen && 
+		   memcmp(a->data, b->data, a->header.keylen) == 0;
+}
+
+// writes the record to a run or, if final, its line to the output
+static int extsort__emit(extsort__reader_t const* const rec, FILE* const out, 
+						 int const final, unique_t const unique)
+{
+	char const* const line = rec->data + rec->header.keylen;
+	if(!final) {
+		return extsort__write_record(out, &rec->header, rec->data, line);
+	}
+
+	if(unique == UNIQUE_COUNT && 
+	   fprintf(out, UNIQUE_COUNT_FORMAT, (size_t)rec->header.count) < 0) {
+		return 0;
+	}
+	return fwrite(line, 1, rec->header.linelen, out) == rec->header.linelen && 
+		   fputc('\n', out) != EOF;
+}
+
+static extsort_err_t extsort__read(extsort__reader_t* const reader)
+{
+	if(fread(&reader->header, sizeof(reader->header), 1, reader->file) != 1) {
+		reader->done = 1;
+		return ferror(reader->file) ? EXTSORT_ERR_TMPFILE : EXTSORT_ERR_OK;
+	}
+
+	size_t const size = (size_t)reader->header.keylen + reader->header.linelen;
+	if(size > reader->capacity) {
+		size_t const capacity = size > 2 * reader->capacity ? size : 2 * reader->capacity;
+		char* const data = (char*)realloc(reader->data, capacity);
+		if(data == NULL) {
+			return EXTSORT_ERR_MEMORY;
+		}
+		reader->data = data;
+		reader->capacity = capacity;
+	}
+
+	if(fread(reader->data, 1, size, reader->file) != size) {
+		return EXTSORT_ERR_TMPFILE;
+	}
+	return EXTSORT_ERR_OK;
+}
+
+// whether the record of reader a goes before the one of b; finished readers go last
+static int extsort__less(extsort__reader_t const* const a, extsort__reader_t const* const b)
+{
+	if(a->done || b->done) {
+		return !a->done;
+	}
+
+	uint32_t const len = a->header.keylen < b->header.keylen ? 
+						 a->header.keylen : b->header.keylen;
+	int const res = memcmp(a->data, b->data, len);
+	if(res != 0) {
+		return res < 0;
+	}
+	if(a->header.keylen != b->header.keylen) {
+		return a->header.keylen < b->header.keylen;
+	}
+	return a->header.line < b->header.line;
+}
+
+/*
+ * Loser tree: tree[0] is the winner, the other nodes keep the losers of their
+ * matches. The leaf nreaders is a virtual reader winning every match, it is only
+ * used to fill the tree initially.
+ */
+static void extsort__adjust(size_t* const tree, extsort__reader_t const* const readers, 
+							size_t const nreaders, size_t winner)
+{
+	for(size_t node = (winner + nreaders) / 2; node > 0; node /= 2) {
+		size_t const other = tree[node];
+		if(other == nreaders || 
+		   (winner != nreaders && extsort__less(&readers[other], &readers[winner]))) {
+			tree[node] = winner;
+			winner = other;
+		}
+	}
+	tree[0] = winner;
+}
+
+// merges the runs into a new run or, if final, into the lines of the output; writes
+// at most top records, 0 for all
+static extsort_err_t extsort__merge(FILE* const* const files, size_t const nfiles, 
+									FILE* const out, int const final, unique_t const unique,
+									size_t const top)
+{
+	extsort__reader_t* const readers = (extsort__reader_t*)calloc(nfiles, 
+																  sizeof(extsort__reader_t));
+	size_t* const tree = (size_t*)calloc(nfiles, sizeof(size_t));
+	if(readers == NULL || tree == NULL) {
+		free(readers);
+		free(tree);
+		return EXTSORT_ERR_MEMORY;
+	}
+
+	extsort_err_t err = EXTSORT_ERR_OK;
+	for(size_t i = 0; i < nfiles; ++i) {
+		readers[i].file = files[i];
+		tree[i] = nfiles;
+		if(err == EXTSORT_ERR_OK) {
+			err = extsort__read(&readers[i]);
+		}
+	}
+
+	if(err == EXTSORT_ERR_OK) {
+		for(size_t i = nfiles; i > 0; --i) {
+			extsort__adjust(tree, readers, nfiles, i - 1);
+		}
+
+		// collapsed records wait here until a record with another key comes
+		extsort__reader_t pending = {};
+		pending.done = 1;
+
+		size_t nwritten = 0;
+		while(!readers[tree[0]].done) {
+			extsort__reader_t* const reader = &readers[tree[0]];
+
+			int written = 1;
+			if(unique == UNIQUE_NONE) {
+				written = extsort__emit(reader, out, final, unique);
+				if(written && ++nwritten == top) {
+					break;
+				}
+			} else if(!pending.done && extsort__keyeq(&pending, reader)) {
+				pending.header.count += reader->header.count;
+			} else {
+				if(!pending.done) {
+					written = extsort__emit(&pending, out, final, unique);
+					if(written && ++nwritten == top) {
+						break;
+					}
+				}
+
+				// the reader takes the old buffer of the pending record
+				extsort__reader_t const tmp = pending;
+				pending = *reader;
+				reader->data = tmp.data;
+				reader->capacity = tmp.capacity;
+			}
+			if(!written) {
+				err = final ? EXTSORT_ERR_WRITE : EXTSORT_ERR_TMPFILE;
+				break;
+			}
+
+			if((err = extsort__read(reader)) != EXTSORT_ERR_OK) {
+				break;
+			}
+			extsort__adjust(tree, readers, nfiles, tree[0]);
+		}
+
+		if(err == EXTSORT_ERR_OK && !pending.done && nwritten != top &&
+		   !extsort__emit(&pending, out, final, unique)) {
+			err = final ? EXTSORT_ERR_WRITE : EXTSORT_ERR_TMPFILE;
+		}
+		free(pending.data);
+	}
+
+	for(size_t i = 0; i < nfiles; ++i) {
+		free(readers[i].data);
+	}
+	free(readers);
+	free(tree);
+	return err;
+}
+
+// merges the runs by at most fanin at once, the runs are closed
+static extsort_err_t extsort__merge_runs(extsort__runs_t* const runs, FILE* const out, 
+										 size_t const fanin, sortquery_t const* const query)
+{
+	while(runs->nfiles > fanin) {
+		extsort__runs_t merged = {};
+
+		for(size_t first = 0; first < runs->nfiles; first += fanin) {
+			size_t const nfiles = runs->nfiles - first < fanin ? 
+								  runs->nfiles - first : fanin;
+
+			FILE* const file = extsort__tmpfile();
+			if(file == NULL) {
+				extsort__runs_free(&merged);
+				return EXTSORT_ERR_TMPFILE;
+			}
+
+			extsort_err_t err = extsort__merge(runs->files + first, nfiles, file, 0, 
+														query->unique, query->top);
+			if(err == EXTSORT_ERR_OK) {
+				err = extsort__run_done(file);
+			}
+			if(err == EXTSORT_ERR_OK) {
+				err = extsort__runs_add(&merged, file);
+			} else {
+				fclose(file);
+			}
+			if(err != EXTSORT_ERR_OK) {
+				extsort__runs_free(&merged);
+				return err;
+			}
+
+			// the merged runs are not needed anymore
+			for(size_t i = first; i < first + nfiles; ++i) {
+				fclose(runs->files[i]);
+				runs->files[i] = NULL;
+			}
+		}
+
+		free(runs->files);
+		*runs = merged;
+	}
+
+	return extsort__merge(runs->files, runs->nfiles, out, 1, query->unique, query->top);
+}
+
+extsort_err_t const extsort(int const fd, extsort_params_t const* const params)
+{$_
+	ASSERT(fd >= 0);
+	ASSERT(params != NULL);
+	ASSERT(params->forward != NULL || params->reverse != NULL || params->original != NULL);
+
+	size_t const mem = params->mem > EXTSORT_MIN_MEM ? params->mem : EXTSORT_MIN_MEM;
+	size_t const norders = (params->forward != NULL) + (params->reverse != NULL);
+
+	// a quarter of the memory keeps the text, the rest is for its keys and lines
+	size_t capacity = mem / 4;
+	size_t const budget = mem - capacity;
+
+	char* buf = (char*)malloc(capacity);
+	if(buf == NULL) {
+		RETURN(EXTSORT_ERR_MEMORY);
+	}
+
+	extsort__runs_t fruns = {};
+	extsort__runs_t rruns = {};
+	extsort_err_t err = EXTSORT_ERR_OK;
+
+	uint64_t line = 0;
+	size_t len = 0;
+	int eof = 0;
+
+	/*
+	 * The text is read in chunks of whole lines rather than with linereader: a chunk
+	 * is split and its keys are built in place, so lines must stay contiguous in one
+	 * buffer that grows for a line longer than it, while linereader hands out one
+	 * line at a time, valid until the next call, and long lines in pieces. Raw
+	 * chunks also go to the original output as they are.
+	 */
+	while(!eof && err == EXTSORT_ERR_OK) {
+		ssize_t const nread = read(fd, buf + len, capacity - len);
+		if(nread < 0) {
+			if(errno != EINTR)
+				err = EXTSORT_ERR_READ;
+			continue;
+		}
+		eof = nread == 0;
+
+		if(params->original != NULL && nread > 0 &&
+		   fwrite(buf + len, 1, (size_t)nread, params->original) != (size_t)nread) {
+			err = EXTSORT_ERR_WRITE;
+			continue;
+		}
+		len += (size_t)nread;
+
+		if(norders == 0 || (!eof && len < capacity)) {
+			if(norders == 0)
+				len = 0;
+			continue;
+		}
+
+		size_t cut = extsort__cut(buf, len, budget, norders);
+		if(!eof && cut == 0) {
+			// the line doesn't fit into the buffer
+			char* const new_buf = (char*)realloc(buf, 2 * capacity);
+			if(new_buf == NULL) {
+				err = EXTSORT_ERR_MEMORY;
+				continue;
+			}
+			buf = new_buf;
+			capacity *= 2;
+			continue;
+		}
+
+		// at the end the chunks are cut until the rest fits, which is the last line
+		while(cut != 0 && err == EXTSORT_ERR_OK && 
+			  (!eof || extsort__cost(len, count_lines(buf, len, '\n'), norders) > budget)) {
+			err = extsort__sort_chunk(buf, cut - 1, &line, params, &fruns, &rruns);
+
+			memmove(buf, buf + cut, len - cut);
+			len -= cut;
+			cut = eof ? extsort__cut(buf, len, budget, norders) : 0;
+		}
+		if(eof && err == EXTSORT_ERR_OK) {
+			err = extsort__sort_chunk(buf, len, &line, params, &fruns, &rruns);
+		}
+	}
+	free(buf);
+
+	// every reader keeps a buffer of a temporary file
+	size_t fanin = mem / (2 * EXTSORT__BUFSIZE);
+	if(fanin < 2) {
+		fanin = 2;
+	}
+
+	if(err == EXTSORT_ERR_OK && params->forward != NULL) {
+		err = extsort__merge_runs(&fruns, params->forward, fanin, &params->query);
+	}
+	if(err == EXTSORT_ERR_OK && params->reverse != NULL) {
+		err = extsort__merge_runs(&rruns, params->reverse, fanin, &params->query);
+	}
+
+	extsort__runs_free(&fruns);
+	extsort__runs_free(&rruns);
+	RETURN(err);
+}
@@ -0,0 +1,64 @@
+#ifndef ONEGIN_EXTSORT_H
+#define ONEGIN_EXTSORT_H
+
+#ifdef __GNUC__
+#	pragma GCC diagnostic ignored "-Wignored-qualifiers"
+#endif /* __GNUC__ */
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "sort.h"
+
+/// Smallest memory limit extsort() accepts, smaller ones are raised to it.
+#define EXTSORT_MIN_MEM (1 << 20)
+
+/// Error codes of extsort().
+typedef enum {
+	EXTSORT_ERR_OK = 0,		///< Terminated successfully.
+	EXTSORT_ERR_MEMORY,		///< Out of memory (malloc returned NULL).
+	EXTSORT_ERR_READ,		///< Failed to read the input. See errno.
+	EXTSORT_ERR_WRITE,		///< Failed to write an output.
+	EXTSORT_ERR_TMPFILE,	///< Failed to create, write or read a temporary file.
+
+	EXTSORT_NERRORS
+} extsort_err_t;
+
+/// Associates error codes of extsort() with error strings.
+char const* const extsort_errstr(extsort_err_t const err);
+
+/// What and how extsort() sorts.
+typedef struct {
+	size_t mem;			///< memory limit in bytes
+	int radix;			///< sort chunks by radix_sort() instead of psort()
+	size_t nthreads;	///< threads of psort(), 0 for the number of processors
+	sortquery_t query;	///< what lines to write
+
+	FILE* forward;		///< output of lines sorted from the beginning or NULL
+	FILE* reverse;		///< output of lines sorted from the end or NULL
+	FILE* original;		///< copy of the input or NULL
+} extsort_params_t;
+
+/**
+ * \brief Sorts lines of a file that may not fit into memory.
+ *
+ * The input is read by chunks that fit into the memory limit together with their
+ * keys. Every chunk is sorted like the whole text is sorted in memory, and written
+ * to a temporary file as a run. Runs are then merged by a loser tree, in several
+ * passes if there are too many of them to be read at once in the limit. The output
+ * is the same as of the in-memory sort: ties are broken by line number.
+ *
+ * Lines with equal keys are collapsed, if asked, as soon as they meet: when a chunk
+ * is written and when runs are merged, so duplicates don't take temporary space.
+ * Likewise lines out of the query range are dropped from chunks, and no run gets
+ * more than the query top lines: a line among the first ones of the whole input is
+ * among the first ones of every part of it.
+ *
+ * A line longer than a quarter of the limit is read whole anyway, exceeding it.
+ *
+ * \param[in] fd input descriptor. Pipes are allowed.
+ * \param[in] params what to write. At least one output must be nonnull.
+ */
+extsort_err_t const extsort(int const fd, extsort_params_t const* const params);
+
+#endif /* ONEGIN_EXTSORT_H */
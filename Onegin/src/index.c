@@ -0,0 +1,328 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <ttrack/dbg.h>
+#include <ttrack/text.h>
+#include <ttrack/hash.h>
+
+#include "collate.h"
+#include "sort.h"
+#include "index.h"
+
+/// First bytes of every index file, the last one is the format version.
+#define INDEX__MAGIC "ONEGIDX1"
+
+static char const* const INDEX__ERRSTR[] = {
+	"no errors",
+	"out of memory",
+	"failed to read or write the index",
+	"the index is damaged",
+	"the index is out of date",
+};
+
+char const* const index_errstr(index_err_t const err)
+{$_
+	ASSERT(0 <= err && err < INDEX_NERRORS);
+	RETURN(INDEX__ERRSTR[err]);
+}
+
+/*
+ * Index file is the header, forward offsets and reverse offsets.
+ */
+typedef struct {
+	char magic[8];
+	index_source_t src;
+	uint64_t nlines;
+} index__header_t;
+
+index_err_t const index_source(index_source_t* const src, char const* const fname,
+							   char const* const text, size_t const size)
+{$_
+	ASSERT(src != NULL);
+	ASSERT(fname != NULL);
+	ASSERT(text != NULL || size == 0);
+
+	struct stat st = {};
+	if(stat(fname, &st) != 0) {
+		RETURN(INDEX_ERR_IO);
+	}
+
+	src->size = size;
+	src->mtime_sec = st.st_mtim.tv_sec;
+	src->mtime_nsec = st.st_mtim.tv_nsec;
+	src->hash = gnu_hash(text, size);
+
+	RETURN(INDEX_ERR_OK);
+}
+
+index_err_t const index_build(char const* const fname, index_source_t const* const src,
+							  char const* const text, size_t const size, int const radix,
+							  size_t const nthreads)
+{$_
+	ASSERT(fname != NULL);
+	ASSERT(src != NULL);
+	ASSERT(text != NULL || size == 0);
+
+	keyorder_t const orders[] = { KEYS_FORWARD, KEYS_REVERSE };
+	sortquery_t const all = {};
+
+	index_err_t err = INDEX_ERR_MEMORY;
+	keyarena_t keys = {};
+	sortrec_t* recs = NULL;
+	uint64_t* offsets = NULL;
+	FILE* file = NULL;
+
+	size_t nlines = 0;
+	// get_text_lines() only reads the text
+	strv_t* const lines = get_text_lines((char*)text, size, '\n', &nlines);
+	if(lines == NULL ||
+	   (offsets = (uint64_t*)calloc(nlines + 1, sizeof(uint64_t))) == NULL ||
+	   !keyarena_init(&keys, lines, nlines, KEYS_FORWARD | KEYS_REVERSE)) {
+		goto cleanup;
+	}
+
+	if((file = fopen(fname, "wb")) == NULL) {
+		err = INDEX_ERR_IO;
+		goto cleanup;
+	}
+
+	index__header_t header = { .src = *src, .nlines = nlines };
+	memcpy(header.magic, INDEX__MAGIC, sizeof(header.magic));
+	if(fwrite(&header, sizeof(header), 1, file) != 1) {
+		err = INDEX_ERR_IO;
+		goto cleanup;
+	}
+
+	for(size_t i = 0; i < 2; ++i) {
+		size_t nrecs = nlines;
+		if((recs = sortrec_make(&keys, keyarena_first(&keys, orders[i]), nlines)) == NULL ||
+		   !sortrec_query(recs, &nrecs, &keys, orders[i], &all, radix, nthreads, NULL)) {
+			goto cleanup;
+		}
+		ASSERT(nrecs == nlines);
+
+		for(size_t k = 0; k < nlines; ++k) {
+			offsets[k] = (uint64_t)(lines[keyarena_line(&keys, recs[k].index)].pfirst - text);
+		}
+		free(recs);
+		recs = NULL;
+
+		if(fwrite(offsets, sizeof(uint64_t), nlines, file) != nlines) {
+			err = INDEX_ERR_IO;
+			goto cleanup;
+		}
+	}
+
+	int const closed = fclose(file) == 0;
+	file = NULL;
+	err = closed ? INDEX_ERR_OK : INDEX_ERR_IO;
+
+cleanup:
+	if(file != NULL) {
+		fclose(file);
+	}
+	if(err != INDEX_ERR_OK) {
+		// a half-written index must not be taken for a valid one
+		remove(fname);
+	}
+
+	keyarena_free(&keys);
+	free(recs);
+	free(offsets);
+	free(lines);
+
+	RETURN(err);
+}
+
+index_err_t const index_open(index_t* const index, char const* const fname,
+							 index_source_t const* const src)
+{$_
+	ASSERT(index != NULL);
+	ASSERT(fname != NULL);
+	ASSERT(src != NULL);
+
+	int const fd = open(fname, O_RDONLY);
+	if(fd < 0) {
+		RETURN(INDEX_ERR_IO);
+	}
+
+	struct stat st = {};
+	if(fstat(fd, &st) != 0) {
+		close(fd);
+		RETURN(INDEX_ERR_IO);
+	}
+	size_t const mapsize = (size_t)st.st_size;
+	if(mapsize < sizeof(index__header_t)) {
+		close(fd);
+		RETURN(INDEX_ERR_FORMAT);
+	}
+
+	void* const map = mmap(NULL, mapsize, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		RETURN(errno == ENOMEM ? INDEX_ERR_MEMORY : INDEX_ERR_IO);
+	}
+
+	index__header_t const* const header = (index__header_t const*)map;
+	index_err_t err = INDEX_ERR_OK;
+
+	if(memcmp(header->magic, INDEX__MAGIC, sizeof(header->magic)) != 0 ||
+	   header->nlines > (mapsize - sizeof(*header)) / (2 * sizeof(uint64_t)) ||
+	   sizeof(*header) + 2 * sizeof(uint64_t) * header->nlines != mapsize) {
+		err = INDEX_ERR_FORMAT;
+	} else if(header->src.size != src->size || header->src.hash != src->hash ||
+			  header->src.mtime_sec != src->mtime_sec ||
+			  header->src.mtime_nsec != src->mtime_nsec) {
+		err = INDEX_ERR_STALE;
+	}
+
+	if(err != INDEX_ERR_OK) {
+		munmap(map, mapsize);
+		RETURN(err);
+	}
+
+	index->map = map;
+	index->mapsize = mapsize;
+	index->nlines = (size_t)header->nlines;
+	index->offsets[0] = (uint64_t const*)(header + 1);
+	index->offsets[1] = index->offsets[0] + index->nlines;
+
+	RETURN(INDEX_ERR_OK);
+}
+
+void index_close(index_t* const index)
+{$_
+	ASSERT(index != NULL);
+
+	if(index->map != NULL) {
+		munmap(index->map, index->mapsize);
+	}
+	*index = (index_t){};
+
+	$$
+}
+
+strv_t const index_line(index_t const* const index, keyorder_t const order,
+						char const* const text, size_t const size, size_t const pos)
+{
+	ASSERT(index != NULL);
+	ASSERT(pos < index->nlines);
+
+	uint64_t const offset = index_offsets(index, order)[pos];
+	strv_t line = { text + size, text + size };
+
+	// offsets of another text of the same size must not take us out of it
+	if(offset <= size) {
+		line.pfirst = text + offset;
+		line.plast = (char const*)memchr(line.pfirst, '\n', size - offset);
+		if(line.plast == NULL)
+			line.plast = text + size;
+	}
+	return line;
+}
+
+/// Compares the key of the line number pos with the bound, or only with its length
+/// if it is a prefix.
+static int index__compare(index_t const* const index, keyorder_t const order,
+						  char const* const text, size_t const size, size_t const pos,
+						  strv_t const* const bound, int const prefix, int* const cmp)
+{
+	strv_t const line = index_line(index, order, text, size, pos);
+	keyarena_t keys = {};
+	if(!keyarena_init(&keys, &line, 1, order))
+		return 0;
+
+	size_t const len = keyarena_len(&keys, 0);
+	size_t const blen = (size_t)(bound->plast - bound->pfirst);
+
+	int res = memcmp(keyarena_key(&keys, 0), bound->pfirst, len < blen ? len : blen);
+	if(res == 0)
+		res = prefix && len >= blen ? 0 : (len > blen) - (len < blen);
+	*cmp = res;
+
+	keyarena_free(&keys);
+	return 1;
+}
+
+/// Finds the first line in [first, last) whose key is not less than the bound (or
+/// greater than it if upper is set).
+static int index__bound(index_t const* const index, keyorder_t const order,
+						char const* const text, size_t const size, strv_t const* const bound,
+						int const prefix, int const upper, size_t first, size_t last,
+						size_t* const pos)
+{
+	while(first < last) {
+		size_t const mid = first + (last - first) / 2;
+
+		int cmp = 0;
+		if(!index__compare(index, order, text, size, mid, bound, prefix, &cmp))
+			return 0;
+
+		if(cmp < 0 || (upper && cmp == 0)) {
+			first = mid + 1;
+		} else {
+			last = mid;
+		}
+	}
+
+	*pos = first;
+	return 1;
+}
+
+index_err_t const index_range(index_t const* const index, keyorder_t const order,
+							  char const* const text, size_t const size,
+							  sortquery_t const* const query, size_t* const pfirst,
+							  size_t* const plast)
+{$_
+	ASSERT(index != NULL);
+	ASSERT(query != NULL);
+	ASSERT(pfirst != NULL);
+	ASSERT(plast != NULL);
+
+	size_t first = 0;
+	size_t last = index->nlines;
+
+	if(query->from != NULL || query->to != NULL || query->prefix != NULL) {
+		keyarena_t bkeys = {};
+		if(!sortquery_keys(query, order, &bkeys)) {
+			RETURN(INDEX_ERR_MEMORY);
+		}
+
+		strv_t bounds[3] = {};
+		for(size_t i = 0; i < 3; ++i) {
+			bounds[i].pfirst = keyarena_key(&bkeys, i);
+			bounds[i].plast = keyarena_key(&bkeys, i) + keyarena_len(&bkeys, i);
+		}
+
+		// the bounds narrow the range one by one
+		int ok = 1;
+		if(ok && query->from != NULL)
+			ok = index__bound(index, order, text, size, &bounds[0], 0, 0, first, last, &first);
+		if(ok && query->to != NULL)
+			ok = index__bound(index, order, text, size, &bounds[1], 0, 0, first, last, &last);
+		if(ok && query->prefix != NULL) {
+			ok = index__bound(index, order, text, size, &bounds[2], 1, 0, first, last,
+							  &first) &&
+				 index__bound(index, order, text, size, &bounds[2], 1, 1, first, last,
+							  &last);
+		}
+
+		keyarena_free(&bkeys);
+		if(!ok) {
+			RETURN(INDEX_ERR_MEMORY);
+		}
+	}
+
+	*pfirst = first;
+	*plast = last;
+	RETURN(INDEX_ERR_OK);
+}
@@ -0,0 +1,116 @@
+#ifndef ONEGIN_INDEX_H
+#define ONEGIN_INDEX_H
+
+#ifdef __GNUC__
+#	pragma GCC diagnostic ignored "-Wignored-qualifiers"
+#endif /* __GNUC__ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <ttrack/strv.h>
+
+#include "collate.h"
+#include "sort.h"
+
+/// Error codes of index functions.
+typedef enum {
+	INDEX_ERR_OK = 0,	///< Terminated successfully.
+	INDEX_ERR_MEMORY,	///< Out of memory (malloc returned NULL).
+	INDEX_ERR_IO,		///< Failed to open, read or write a file. See errno.
+	INDEX_ERR_FORMAT,	///< The file is not an index or it is damaged.
+	INDEX_ERR_STALE,	///< The index was built for another text.
+
+	INDEX_NERRORS
+} index_err_t;
+
+/// Associates error codes of index functions with error strings.
+char const* const index_errstr(index_err_t const err);
+
+/// What the index was built for. The index is valid only for the same text.
+typedef struct {
+	uint64_t size;			///< size of the text in bytes
+	int64_t mtime_sec;		///< modification time of the text file
+	int64_t mtime_nsec;
+	uint64_t hash;			///< gnu_hash() of the text
+} index_source_t;
+
+/**
+ * \brief Describes the text of the file.
+ *
+ * \param[out] src the description.
+ * \param[in] fname name of the text file. Must be nonnull.
+ * \param[in] text the whole text of the file, unmodified.
+ * \param[in] size size of the text.
+ */
+index_err_t const index_source(index_source_t* const src, char const* const fname,
+							   char const* const text, size_t const size);
+
+/**
+ * \brief Sorts lines of the text in both orders and writes their offsets to the
+ * index file.
+ *
+ * The file is the header with the source and the number of lines followed by two
+ * arrays of 64-bit offsets of line starts in the text: sorted from the beginning
+ * and from the end. Numbers are in the byte order of the machine, so the file is
+ * used as is by mmap().
+ *
+ * \param[in] fname name of the index file. It is replaced.
+ * \param[in] src description of the text made by index_source().
+ * \param[in] text the text.
+ * \param[in] size size of the text.
+ * \param[in] radix sort by radix_sort() instead of psort().
+ * \param[in] nthreads threads of psort().
+ */
+index_err_t const index_build(char const* const fname, index_source_t const* const src,
+							  char const* const text, size_t const size, int const radix,
+							  size_t const nthreads);
+
+/// Index file mapped to memory.
+typedef struct {
+	void* map;
+	size_t mapsize;
+	size_t nlines;
+	uint64_t const* offsets[2];	///< line offsets sorted forward and reverse
+} index_t;
+
+/**
+ * \brief Maps the index file if it is valid for the source.
+ *
+ * \return INDEX_ERR_STALE if the index was built for another text.
+ *
+ * \warning You have to call index_close() if the function succeeded.
+ */
+index_err_t const index_open(index_t* const index, char const* const fname,
+							 index_source_t const* const src);
+
+/// Unmaps the index file.
+void index_close(index_t* const index);
+
+/// Sorted offsets of the order.
+static inline uint64_t const* index_offsets(index_t const* const index,
+											keyorder_t const order)
+{
+	return index->offsets[order == KEYS_FORWARD ? 0 : 1];
+}
+
+/**
+ * \brief Returns line number pos (counting from 0) of the order. The line ends at the
+ * first '\n' after its start or at the end of the text.
+ */
+strv_t const index_line(index_t const* const index, keyorder_t const order,
+						char const* const text, size_t const size, size_t const pos);
+
+/**
+ * \brief Finds lines of the order from the query from (inclusive) to the query to
+ * (exclusive) that start with the query prefix by binary search. They are sorted,
+ * so they are the lines from *pfirst to *plast.
+ *
+ * Unique and top of the query are not applied.
+ */
+index_err_t const index_range(index_t const* const index, keyorder_t const order,
+							  char const* const text, size_t const size,
+							  sortquery_t const* const query, size_t* const pfirst,
+							  size_t* const plast);
+
+#endif /* ONEGIN_INDEX_H */
@@ -1,13 +1,23 @@
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <stdint.h>
 #include <string.h>
-#include <ctype.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
 
 #include <ttrack/dbg.h>
 #include <ttrack/text.h>
 
+#include "collate.h"
+#include "sort.h"
+#include "extsort.h"
+#include "index.h"
+
 #ifdef __GNUC__
 
 // I like to return const values from functions, but GCC doesn't.
@@ -20,105 +30,602 @@
 #	include <ttrack/test.h>
 #endif /* TESTS */
 
+#define ERR(...) 										\
+	do {												\
+		fprintf(stderr, "[ERROR] " __VA_ARGS__);		\
+		fputc('\n', stderr);							\
+	} while(0)
+
 int Comparator(void const* vs1, void const* vs2);
 void Test_Comparator();
 
-int RComparator(void const* vs1, void const* vs2);
-void Test_RComparator();
+void Test_ReverseKeys();
+void Test_Utf8Keys();
+
+int KeyComparator(void const* vr1, void const* vr2, void* vkeys);
+void Test_KeyComparator();
+
+void Test_psort();
+void Test_radix_sort();
+void Test_sortrec_unique();
+void Test_sortrec_top();
+void Test_index();
+
+/// Command line options.
+typedef struct {
+	char const* input;		///< input file name, "-" for stdin
+	char const* forward;	///< output names, "-" for stdout, NULL if not needed
+	char const* reverse;
+	char const* original;
+
+	int radix;
+	size_t mem;				///< memory limit of the external sort, 0 to sort in memory
+	char const* index;		///< index file name or NULL
+	sortquery_t query;
+	int help;
+} Options;
+
+/// Query of records of one order to be run by another thread.
+typedef struct {
+	sortrec_t* recs;
+	size_t nrecs;			///< number of records, then number of records left
+	keyarena_t const* keys;
+	keyorder_t order;
+	Options const* opts;
+	size_t nthreads;
+	size_t* counts;
+	int ok;
+} SortTask;
 
-int main() {
+void* RunSortTask(void* vtask);
+
+size_t ParseSize(char const* str);
+int ParseOptions(int argc, char* argv[], Options* opts);
+
+FILE* OpenOutput(char const* filename);
+int CloseOutput(FILE* file);
+
+int SortInMemory(Options const* opts, FILE* forward, FILE* reverse, FILE* original);
+int SortText(Options const* opts, char* text, size_t size, FILE* forward, FILE* reverse);
+int WriteSorted(FILE* file, strv_t const* lines, keyarena_t const* keys, 
+				sortrec_t const* recs, size_t nrecs, size_t const* counts, strv_t* buffer);
+int SortExternal(Options const* opts, FILE* forward, FILE* reverse, FILE* original);
+int SortIndexed(Options const* opts, char const* text, size_t size, FILE* forward,
+				FILE* reverse);
+int WriteIndexed(FILE* file, index_t const* index, keyorder_t order, char const* text,
+				 size_t size, sortquery_t const* query);
+
+static char const USAGE[] = 
+	"usage: onegin [options] [input]\n"
+	"Sorts lines of the input (Shakespeare.txt by default, - for stdin) by their letters.\n"
+	"\n"
+	"  -f, --forward=FILE     write lines sorted from the beginning\n"
+	"  -r, --reverse=FILE     write lines sorted from the end\n"
+	"  -o, --original=FILE    write the input as is\n"
+	"                         FILE - is stdout. Without these options the outputs are\n"
+	"                         Sorted.txt, FTOBSorted.txt and Original.rxt\n"
+	"  -u, --unique           write only the first of lines with equal letters\n"
+	"  -c, --count            as --unique, prefixing lines with the number of equal ones\n"
+	"  -k, --top=K            write only the first K lines\n"
+	"      --from=LINE        write only lines sorted not before LINE\n"
+	"      --to=LINE          write only lines sorted before LINE; in the reverse order\n"
+	"                         LINE is read from the end too\n"
+	"      --prefix=LINE      write only lines starting with the letters of LINE; in the\n"
+	"                         reverse order ending with them\n"
+	"      --index=FILE       keep lines of the input sorted in FILE and sort them again\n"
+	"                         only if the input changed\n"
+	"      --sort=merge|radix sorting algorithm, merge by default\n"
+	"      --mem=SIZE[K|M|G]  sort the input by parts in the memory limit\n"
+	"  -h, --help             print this message\n";
+
+int main(int argc, char* argv[]) {
 #ifdef TESTS
 	Test_Comparator();
-	Test_RComparator();
+	Test_ReverseKeys();
+	Test_Utf8Keys();
+	Test_KeyComparator();
+	Test_psort();
+	Test_radix_sort();
+	Test_sortrec_unique();
+	Test_sortrec_top();
+	Test_index();
 #endif
 
-	char const* filename = "Shakespeare.txt";
-	
-	size_t size = 0;
-	RF_err_t rf_err;
+	Options opts = {};
+	if(!ParseOptions(argc, argv, &opts)) {
+		fputs(USAGE, stderr);
+		return(EXIT_FAILURE);
+	}
+	if(opts.help) {
+		fputs(USAGE, stdout);
+		return(EXIT_SUCCESS);
+	}
+
+	FILE* const forward = OpenOutput(opts.forward);
+	FILE* const reverse = OpenOutput(opts.reverse);
+	FILE* const original = OpenOutput(opts.original);
+
+	int ret = EXIT_FAILURE;
+	if((opts.forward != NULL && forward == NULL) || (opts.reverse != NULL && reverse == NULL) ||
+	   (opts.original != NULL && original == NULL)) {
+		ERR("failed to open an output file");
+	} else if(opts.mem != 0) {
+		ret = SortExternal(&opts, forward, reverse, original);
+	} else {
+		ret = SortInMemory(&opts, forward, reverse, original);
+	}
+
+	FILE* const outputs[] = { forward, reverse, original };
+	for(size_t i = 0; i < sizeof(outputs) / sizeof(outputs[0]); ++i) {
+		if(!CloseOutput(outputs[i]) && ret == EXIT_SUCCESS) {
+			ERR("internal IO error");
+			ret = EXIT_FAILURE;
+		}
+	}
+
+	return(ret);
+}
+
+/// Parses a size in bytes with an optional K, M or G suffix. Returns 0 if invalid.
+size_t ParseSize(char const* str)
+{
+	char* end = NULL;
+	unsigned long long const size = strtoull(str, &end, 10);
+	if(end == str)
+		return 0;
+
+	int shift = 0;
+	switch(*end) {
+	case 'K': case 'k': shift = 10; ++end; break;
+	case 'M': case 'm': shift = 20; ++end; break;
+	case 'G': case 'g': shift = 30; ++end; break;
+	default: break;
+	}
+
+	if(*end != '\0' || size > (SIZE_MAX >> shift))
+		return 0;
+	return (size_t)size << shift;
+}
 
-	char* const text = read_text2(filename, &size, &rf_err);
-	if(text == 0) {
-		switch(rf_err) {
-		case RF_NOTFOUND:
-			ERR("file \'%s\' not found", filename);
+/// Fills the options from the command line. Returns 0 if they are invalid.
+int ParseOptions(int argc, char* argv[], Options* opts)
+{
+	enum { OPT_SORT = 256, OPT_MEM, OPT_FROM, OPT_TO, OPT_PREFIX, OPT_INDEX };
+	static struct option const LONGOPTS[] = {
+		{ "forward",  required_argument, NULL, 'f' },
+		{ "reverse",  required_argument, NULL, 'r' },
+		{ "original", required_argument, NULL, 'o' },
+		{ "unique",   no_argument,       NULL, 'u' },
+		{ "count",    no_argument,       NULL, 'c' },
+		{ "top",      required_argument, NULL, 'k' },
+		{ "from",     required_argument, NULL, OPT_FROM },
+		{ "to",       required_argument, NULL, OPT_TO },
+		{ "prefix",   required_argument, NULL, OPT_PREFIX },
+		{ "index",    required_argument, NULL, OPT_INDEX },
+		{ "sort",     required_argument, NULL, OPT_SORT },
+		{ "mem",      required_argument, NULL, OPT_MEM },
+		{ "help",     no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+
+	int opt = 0;
+	while((opt = getopt_long(argc, argv, "f:r:o:uck:h", LONGOPTS, NULL)) != -1) {
+		switch(opt) {
+		case 'f': opts->forward = optarg; break;
+		case 'r': opts->reverse = optarg; break;
+		case 'o': opts->original = optarg; break;
+		case 'u': 
+			if(opts->query.unique == UNIQUE_NONE)
+				opts->query.unique = UNIQUE_FIRST;
 			break;
+		case 'c': opts->query.unique = UNIQUE_COUNT; break;
 
-		default:
-			ERR(RF_errstr(rf_err));
+		case 'k': {
+			char* end = NULL;
+			unsigned long long const top = strtoull(optarg, &end, 10);
+			if(end == optarg || *end != '\0' || top == 0 || top > SIZE_MAX) {
+				ERR("invalid number of lines \'%s\'", optarg);
+				return 0;
+			}
+			opts->query.top = (size_t)top;
+			break;
+		}
+
+		case OPT_FROM: opts->query.from = optarg; break;
+		case OPT_TO: opts->query.to = optarg; break;
+		case OPT_PREFIX: opts->query.prefix = optarg; break;
+		case OPT_INDEX: opts->index = optarg; break;
+
+		case OPT_SORT:
+			if(strcmp(optarg, "merge") == 0) {
+				opts->radix = 0;
+			} else if(strcmp(optarg, "radix") == 0) {
+				opts->radix = 1;
+			} else {
+				ERR("unknown sorting algorithm \'%s\'", optarg);
+				return 0;
+			}
 			break;
+
+		case OPT_MEM:
+			if((opts->mem = ParseSize(optarg)) == 0) {
+				ERR("invalid memory size \'%s\'", optarg);
+				return 0;
+			}
+			break;
+
+		case 'h': 
+			opts->help = 1; 
+			return 1;
+
+		default:
+			return 0;
+		}
+	}
+
+	if(optind + 1 < argc) {
+		ERR("too many input files");
+		return 0;
+	}
+	opts->input = optind < argc ? argv[optind] : "Shakespeare.txt";
+
+	if(opts->index != NULL && strcmp(opts->input, "-") == 0) {
+		ERR("the index needs an input file");
+		return 0;
+	}
+	if(opts->index != NULL && opts->mem != 0) {
+		ERR("the index can't be used with --mem");
+		return 0;
+	}
+
+	if(opts->forward == NULL && opts->reverse == NULL && opts->original == NULL) {
+		opts->forward = "Sorted.txt";
+		opts->reverse = "FTOBSorted.txt";
+		opts->original = "Original.rxt";
+	}
+	return 1;
+}
+
+/// Opens the output file, "-" is stdout. NULL name is no output and gives NULL.
+FILE* OpenOutput(char const* filename)
+{
+	if(filename == NULL)
+		return NULL;
+	if(strcmp(filename, "-") == 0)
+		return stdout;
+
+	return fopen(filename, "w");
+}
+
+/// Closes the output, stdout is only flushed. Returns 0 if writing failed.
+int CloseOutput(FILE* file)
+{
+	if(file == NULL)
+		return 1;
+	if(file == stdout)
+		return fflush(file) == 0 && !ferror(file);
+
+	int const ok = !ferror(file);
+	return fclose(file) == 0 && ok;
+}
+
+/// Reads the whole input, writes the original and sorts it.
+int SortInMemory(Options const* opts, FILE* forward, FILE* reverse, FILE* original)
+{
+	size_t size = 0;
+	char* text = NULL;
+
+	if(strcmp(opts->input, "-") == 0) {
+		RT_err_t rt_err = RT_OK;
+		text = map_text(stdin, MT_PRIVATE, &size, &rt_err);
+		if(text == NULL) {
+			ERR("%s", rt_err == RT_MEMORY ? "out of memory" : "failed to read stdin");
+			return(EXIT_FAILURE);
 		}
+	} else {
+		RF_err_t rf_err = RF_OK;
+		text = map_text2(opts->input, MT_PRIVATE, &size, &rf_err);
+		if(text == NULL) {
+			switch(rf_err) {
+			case RF_NOTFOUND:
+				ERR("file \'%s\' not found", opts->input);
+				break;
+
+			default:
+				ERR("%s", RF_errstr(rf_err));
+				break;
+			}
+			return(EXIT_FAILURE);
+		}
+	}
+
+	int ret = EXIT_SUCCESS;
+	if(original != NULL && fwrite(text, sizeof(char), size, original) != size) {
+		ERR("internal IO error");
+		ret = EXIT_FAILURE;
+	} else if(opts->index != NULL && (forward != NULL || reverse != NULL)) {
+		ret = SortIndexed(opts, text, size, forward, reverse);
+	} else if(forward != NULL || reverse != NULL) {
+		ret = SortText(opts, text, size, forward, reverse);
 	}
 
+	unmap_text(text, size);
+	return(ret);
+}
+
+/// Sorts lines of the text by the orders whose outputs are nonnull.
+int SortText(Options const* opts, char* text, size_t size, FILE* forward, FILE* reverse)
+{
+	FILE* const outputs[] = { forward, reverse };
+	keyorder_t const orders[] = { KEYS_FORWARD, KEYS_REVERSE };
+
+	int ret = EXIT_FAILURE;
+	keyarena_t keys = {};
+	sortrec_t* recs[] = { NULL, NULL };
+	size_t* counts[] = { NULL, NULL };
+	strv_t* sorted = NULL;
+
 	size_t nlines = 0;
-	string_t* lines1 = get_text_lines(text, size, &nlines);
-	if(lines1 == NULL) {
-		free(text);
+	strv_t* const lines = get_text_lines(text, size, '\n', &nlines);
+	if(lines == NULL) {
 		ERR("out of memory");
+		goto cleanup;
 	}
 
-	string_t* lines2 = (string_t*)calloc(sizeof(string_t), nlines);
-	if(lines2 == NULL) {
-		free(lines1);
-		free(text);
+	sorted = (strv_t*)calloc(nlines + 1, sizeof(strv_t));
+	if(sorted == NULL ||
+	   !keyarena_init(&keys, lines, nlines, (forward != NULL ? KEYS_FORWARD : 0) | 
+											(reverse != NULL ? KEYS_REVERSE : 0))) {
+		ERR("out of memory");
+		goto cleanup;
+	}
+
+	for(size_t i = 0; i < 2; ++i) {
+		if(outputs[i] == NULL)
+			continue;
+
+		if((recs[i] = sortrec_make(&keys, keyarena_first(&keys, orders[i]), nlines)) == NULL) {
+			ERR("out of memory or too many lines");
+			goto cleanup;
+		}
+		if(opts->query.unique == UNIQUE_COUNT &&
+		   (counts[i] = (size_t*)calloc(nlines + 1, sizeof(size_t))) == NULL) {
+			ERR("out of memory");
+			goto cleanup;
+		}
+	}
+
+	// forward and reverse sorts share the processors
+	long const ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t const nthreads = ncpus > 1 ? (size_t)ncpus : 1;
+	size_t const rthreads = forward != NULL ? nthreads / 2 : nthreads;
+
+	SortTask task = { recs[0], nlines, &keys, KEYS_FORWARD, opts, nthreads - rthreads, 
+					  counts[0], 0 };
+	SortTask rtask = { recs[1], nlines, &keys, KEYS_REVERSE, opts, rthreads > 0 ? rthreads : 1,
+					   counts[1], 0 };
+
+	if(forward == NULL) {
+		RunSortTask(&rtask);
+	} else if(reverse == NULL) {
+		RunSortTask(&task);
+	} else {
+		pthread_t rthread;
+		int const rstarted = pthread_create(&rthread, NULL, RunSortTask, &rtask) == 0;
+
+		RunSortTask(&task);
+
+		if(rstarted) {
+			pthread_join(rthread, NULL);
+		} else {
+			RunSortTask(&rtask);
+		}
+	}
+
+	SortTask const* const tasks[] = { &task, &rtask };
+	for(size_t i = 0; i < 2; ++i) {
+		if(outputs[i] == NULL)
+			continue;
 
+		if(!tasks[i]->ok) {
+			ERR("out of memory");
+			goto cleanup;
+		}
+		if(!WriteSorted(outputs[i], lines, &keys, recs[i], tasks[i]->nrecs, counts[i], sorted)) {
+			ERR("internal IO error");
+			goto cleanup;
+		}
+	}
+
+	ret = EXIT_SUCCESS;
+
+cleanup:
+	keyarena_free(&keys);
+	free(recs[0]);
+	free(recs[1]);
+	free(counts[0]);
+	free(counts[1]);
+	free(sorted);
+	free(lines);
+
+	return(ret);
+}
+
+/// Writes lines of the records, prefixed by counts if they are nonnull.
+int WriteSorted(FILE* file, strv_t const* lines, keyarena_t const* keys, 
+				sortrec_t const* recs, size_t nrecs, size_t const* counts, strv_t* buffer)
+{
+	if(counts == NULL) {
+		for(size_t i = 0; i < nrecs; ++i) {
+			buffer[i] = lines[keyarena_line(keys, recs[i].index)];
+		}
+		return write_lines(file, buffer, nrecs);
+	}
+
+	for(size_t i = 0; i < nrecs; ++i) {
+		strv_t const* const line = &lines[keyarena_line(keys, recs[i].index)];
+		size_t const len = (size_t)(line->plast - line->pfirst);
+
+		if(fprintf(file, UNIQUE_COUNT_FORMAT, counts[i]) < 0 || 
+		   fwrite(line->pfirst, sizeof(char), len, file) != len || fputc('\n', file) == EOF)
+			return 0;
+	}
+	return 1;
+}
+
+/// Sorts the input in the memory limit, writes the same outputs as SortInMemory().
+int SortExternal(Options const* opts, FILE* forward, FILE* reverse, FILE* original)
+{
+	int const from_stdin = strcmp(opts->input, "-") == 0;
+	int const fd = from_stdin ? STDIN_FILENO : open(opts->input, O_RDONLY);
+	if(fd < 0) {
+		ERR("file \'%s\' not found", opts->input);
+		return(EXIT_FAILURE);
+	}
+
+	extsort_params_t const params = { opts->mem, opts->radix, 0, opts->query, 
+									  forward, reverse, original };
+
+	int ret = EXIT_SUCCESS;
+	extsort_err_t const err = extsort(fd, &params);
+	if(err != EXTSORT_ERR_OK) {
+		ERR("%s", extsort_errstr(err));
+		ret = EXIT_FAILURE;
+	}
+
+	if(!from_stdin)
+		close(fd);
+	return(ret);
+}
+
+/// Writes the outputs from the index, building it first if it is not valid for the text.
+int SortIndexed(Options const* opts, char const* text, size_t size, FILE* forward,
+				FILE* reverse)
+{
+	index_source_t src = {};
+	if(index_source(&src, opts->input, text, size) != INDEX_ERR_OK) {
+		ERR("file \'%s\' not found", opts->input);
+		return(EXIT_FAILURE);
+	}
+
+	index_t index = {};
+	index_err_t err = index_open(&index, opts->index, &src);
+	if(err != INDEX_ERR_OK && err != INDEX_ERR_MEMORY) {
+		long const ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		err = index_build(opts->index, &src, text, size, opts->radix, 
+						  ncpus > 1 ? (size_t)ncpus : 1);
+
+		if(err == INDEX_ERR_OK)
+			err = index_open(&index, opts->index, &src);
+	}
+	if(err != INDEX_ERR_OK) {
+		ERR("%s", index_errstr(err));
+		return(EXIT_FAILURE);
+	}
+
+	int ret = EXIT_SUCCESS;
+	if((forward != NULL && 
+		!WriteIndexed(forward, &index, KEYS_FORWARD, text, size, &opts->query)) ||
+	   (reverse != NULL && 
+		!WriteIndexed(reverse, &index, KEYS_REVERSE, text, size, &opts->query))) {
+		ret = EXIT_FAILURE;
+	}
+
+	index_close(&index);
+	return(ret);
+}
+
+/// Writes lines of the query in the order from the index. Only the lines of the range
+/// get their keys, and only if they are to be unique.
+int WriteIndexed(FILE* file, index_t const* index, keyorder_t order, char const* text,
+				 size_t size, sortquery_t const* query)
+{
+	size_t first = 0;
+	size_t last = 0;
+	if(index_range(index, order, text, size, query, &first, &last) != INDEX_ERR_OK) {
 		ERR("out of memory");
+		return 0;
 	}
-	memcpy(lines2, lines1, sizeof(string_t) * nlines);
 
-	qsort(lines1, nlines, sizeof(string_t), Comparator);
-	qsort(lines2, nlines, sizeof(string_t), RComparator);
+	size_t nlines = last - first;
+	if(query->unique == UNIQUE_NONE && query->top != 0 && nlines > query->top)
+		nlines = query->top;
 
-	int errc1 = write_lines2("Sorted.txt", lines1, nlines);
-	int errc2 = write_lines2("FTOBSorted.txt", lines2, nlines);
+	int ok = 0;
+	keyarena_t keys = {};
+	sortrec_t* recs = NULL;
+	size_t* counts = NULL;
 
-	if(!errc1 || !errc2) {
-		free(lines1);
-		free(lines2);
-		free(text);
-		ERR("internal IO error");
+	strv_t* const lines = (strv_t*)calloc(nlines + 1, sizeof(strv_t));
+	strv_t* const sorted = (strv_t*)calloc(nlines + 1, sizeof(strv_t));
+	if(lines == NULL || sorted == NULL) {
+		ERR("out of memory");
+		goto cleanup;
+	}
+	for(size_t i = 0; i < nlines; ++i) {
+		lines[i] = index_line(index, order, text, size, first + i);
 	}
 
-	repair_text(text, size);
+	if(query->unique == UNIQUE_NONE) {
+		if(!(ok = write_lines(file, lines, nlines)))
+			ERR("internal IO error");
+		goto cleanup;
+	}
 
-	if(!write_text("Original.rxt", text, size)) {
-		free(lines1);
-		free(lines2);
-		free(text);
-		ERR("internal IO error");
+	// the lines are sorted already, so equal ones are neighbours
+	if(!keyarena_init(&keys, lines, nlines, order) ||
+	   (recs = sortrec_make(&keys, keyarena_first(&keys, order), nlines)) == NULL ||
+	   (query->unique == UNIQUE_COUNT &&
+		(counts = (size_t*)calloc(nlines + 1, sizeof(size_t))) == NULL)) {
+		ERR("out of memory");
+		goto cleanup;
 	}
 
-	free(lines1);
-	free(lines2);
-	free(text);
+	size_t nrecs = sortrec_unique(recs, nlines, &keys, counts);
+	if(query->top != 0 && nrecs > query->top)
+		nrecs = query->top;
 
-	return(EXIT_SUCCESS);
+	if(!(ok = WriteSorted(file, lines, &keys, recs, nrecs, counts, sorted)))
+		ERR("internal IO error");
+
+cleanup:
+	keyarena_free(&keys);
+	free(recs);
+	free(counts);
+	free(sorted);
+	free(lines);
+
+	return ok;
 }
 
+/// Compares lines by their letters, case insensitive. Reference for the collation keys.
 int Comparator(void const* vs1, void const* vs2) 
 {
-	string_t* s1 = (string_t*)vs1;
-	string_t* s2 = (string_t*)vs2;
+	strv_t const* s1 = (strv_t const*)vs1;
+	strv_t const* s2 = (strv_t const*)vs2;
 
 	assert(s1 != NULL);
 	assert(s2 != NULL);
 
-	char* p1 = s1->first;
-	char* p2 = s2->first;
+	char const* p1 = s1->pfirst;
+	char const* p2 = s2->pfirst;
 
-	while(p1 < s1->last && p2 < s2->last) {
-		while(!isalpha(*p1) && p1 < s1->last) ++p1;
-		while(!isalpha(*p2) && p2 < s2->last) ++p2;
+	unsigned c1 = 0;
+	unsigned c2 = 0;
+	while(1) {
+		c1 = c2 = 0;
+		while(p1 < s1->plast && (c1 = collate_letter(&p1, s1->plast)) == 0) {}
+		while(p2 < s2->plast && (c2 = collate_letter(&p2, s2->plast)) == 0) {}
 
-		if		(tolower(*p1) < tolower(*p2)) { return -1; }
-		else if (tolower(*p1) > tolower(*p2)) { return 1; }
+		if(c1 == 0 || c2 == 0)
+			break;
 
-		++p1;
-		++p2;
+		if		(c1 < c2) { return -1; }
+		else if (c1 > c2) { return 1; }
 	}
 	
-	if 		(s1->last - p1 < s2->last - p2) { return -1; }
-	else if	(s1->last - p1 > s2->last - p2) { return 1; }
+	if 		(c1 == 0 && c2 != 0) { return -1; }
+	else if	(c1 != 0 && c2 == 0) { return 1; }
 	else 			  { return 0; }
 
 }
@@ -126,89 +633,397 @@ void Test_Comparator()
 {
 	{
 		char* TEST_STRING = "abcde";
-		string_t s1 = { TEST_STRING, TEST_STRING + strlen(TEST_STRING) };
-		string_t s2 = { TEST_STRING, TEST_STRING + strlen(TEST_STRING) };
+		strv_t s1 = { TEST_STRING, TEST_STRING + strlen(TEST_STRING) };
+		strv_t s2 = { TEST_STRING, TEST_STRING + strlen(TEST_STRING) };
 		TEST_IRV(Comparator(&s1, &s2), 0);
 	}
 	{
 		char* TEST_STRING1 = "a   b,,,c , , ,de";
 		char* TEST_STRING2 = "a,./,b     c.,.,.de";
-		string_t s1 = { TEST_STRING1, TEST_STRING1 + strlen(TEST_STRING1) };
-		string_t s2 = { TEST_STRING2, TEST_STRING2 + strlen(TEST_STRING2) };
+		strv_t s1 = { TEST_STRING1, TEST_STRING1 + strlen(TEST_STRING1) };
+		strv_t s2 = { TEST_STRING2, TEST_STRING2 + strlen(TEST_STRING2) };
 		TEST_IRV(Comparator(&s1, &s2), 0);
 	}
 	{
 		char* TEST_STRING1 = "a   b,,,c , , ,dz";
 		char* TEST_STRING2 = "a,./,b     c.,.,.de";
-		string_t s1 = { TEST_STRING1, TEST_STRING1 + strlen(TEST_STRING1) };
-		string_t s2 = { TEST_STRING2, TEST_STRING2 + strlen(TEST_STRING2) };
+		strv_t s1 = { TEST_STRING1, TEST_STRING1 + strlen(TEST_STRING1) };
+		strv_t s2 = { TEST_STRING2, TEST_STRING2 + strlen(TEST_STRING2) };
 		TEST_IRV(Comparator(&s1, &s2), 1);
 	}
 	{
 		char* TEST_STRING1 = "a   b,,,c , , ,da";
 		char* TEST_STRING2 = "a,./,b     c.,.,.de";
-		string_t s1 = { TEST_STRING1, TEST_STRING1 + strlen(TEST_STRING1) };
-		string_t s2 = { TEST_STRING2, TEST_STRING2 + strlen(TEST_STRING2) };
+		strv_t s1 = { TEST_STRING1, TEST_STRING1 + strlen(TEST_STRING1) };
+		strv_t s2 = { TEST_STRING2, TEST_STRING2 + strlen(TEST_STRING2) };
 		TEST_IRV(Comparator(&s1, &s2), -1);
 	}
 
 }
 
-int RComparator(void const* vs1, void const* vs2) 
+// reversed keys compare lines by their letters read from the end
+static int ReverseKeyCompare(char const* str1, char const* str2)
 {
-	string_t* s1 = (string_t*)vs1;
-	string_t* s2 = (string_t*)vs2;
+	strv_t const lines[] = { 
+		{ str1, str1 + strlen(str1) }, 
+		{ str2, str2 + strlen(str2) }, 
+	};
 
-	assert(s1 != NULL);
-	assert(s2 != NULL);
+	keyarena_t keys = {};
+	if(!keyarena_init(&keys, lines, 2, KEYS_REVERSE))
+		return -2;
 
-	char* p1 = s1->last;
-	char* p2 = s2->last;
+	size_t const len1 = keyarena_len(&keys, 0);
+	size_t const len2 = keyarena_len(&keys, 1);
+	int res = memcmp(keyarena_key(&keys, 0), keyarena_key(&keys, 1), 
+					 len1 < len2 ? len1 : len2);
+	if(res == 0)
+		res = (len1 > len2) - (len1 < len2);
 
-	while(p1 >= s1->first && p2 >= s2->first) {
-		while(!isalpha(*p1) && p1 >= s1->first) --p1;
-		while(!isalpha(*p2) && p2 >= s2->first) --p2;
+	keyarena_free(&keys);
+	return (res > 0) - (res < 0);
+}
+void Test_ReverseKeys() 
+{
+	TEST_IRV(ReverseKeyCompare("abcde", "abcde"), 0);
+	TEST_IRV(ReverseKeyCompare("a   b,,,c , , ,de", "a,./,b     c.,.,.de"), 0);
+	TEST_IRV(ReverseKeyCompare("z   b,,,c , , ,de", "a,./,b     c.,.,.de"), 1);
+	TEST_IRV(ReverseKeyCompare("a   b,,,c , , ,da", "e,./,b     c.,.,.da"), -1);
+	TEST_IRV(ReverseKeyCompare("Ab, c!", "..bc"), 1);
+	TEST_IRV(ReverseKeyCompare("", ",,"), 0);
+	TEST_IRV(ReverseKeyCompare("мир", "МИР!"), 0);
+	TEST_IRV(ReverseKeyCompare("мир", "пир"), -1);
+	TEST_IRV(ReverseKeyCompare("кот", "ток"), 1);
+	TEST_IRV(ReverseKeyCompare("Übung", "übunG"), 0);
+}
 
-		if		(tolower(*p1) < tolower(*p2)) { return -1; }
-		else if (tolower(*p1) > tolower(*p2)) { return 1; }
+void Test_Utf8Keys()
+{
+	char* TEST_STRINGS[] = { "Ёж, Äb!", "\xd0\xd0\x96 \xe2\x80\x94 İ\xf0\x9f\x99\x82" };
+	char* TEST_KEYS[] = { "ежäb", "жi", "bäже", "iж" };
+	size_t const n = sizeof(TEST_STRINGS) / sizeof(TEST_STRINGS[0]);
 
-		--p1;
-		--p2;
+	strv_t lines[sizeof(TEST_STRINGS) / sizeof(TEST_STRINGS[0])];
+	for(size_t i = 0; i < n; ++i) {
+		lines[i].pfirst = TEST_STRINGS[i];
+		lines[i].plast = TEST_STRINGS[i] + strlen(TEST_STRINGS[i]);
 	}
-	
-	if 		(s1->last - p1 > s2->last - p2) { return -1; }
-	else if	(s1->last - p1 < s2->last - p2) { return 1; }
-	else 			  { return 0; }
 
+	for(int orders = KEYS_FORWARD; orders <= (KEYS_FORWARD | KEYS_REVERSE); ++orders) {
+		keyarena_t keys = {};
+		if(!keyarena_init(&keys, lines, n, orders))
+			continue;
+
+		for(size_t k = 0; k < keys.nkeys; ++k) {
+			char const* const ref = TEST_KEYS[orders == KEYS_REVERSE ? k + n : k];
+			TEST_IRV((int)keyarena_len(&keys, k), (int)strlen(ref));
+			TEST_IRV(memcmp(keyarena_key(&keys, k), ref, strlen(ref)), 0);
+		}
+		keyarena_free(&keys);
+	}
 }
-void Test_RComparator() 
+
+/// Compares sort records of precomputed keys, see sortrec_cmp().
+int KeyComparator(void const* vr1, void const* vr2, void* vkeys)
 {
-	{
-		char* TEST_STRING = "abcde";
-		string_t s1 = { TEST_STRING, TEST_STRING + strlen(TEST_STRING) };
-		string_t s2 = { TEST_STRING, TEST_STRING + strlen(TEST_STRING) };
-		TEST_IRV(Comparator(&s1, &s2), 0);
+	return sortrec_cmp((sortrec_t const*)vr1, (sortrec_t const*)vr2, 
+					   (keyarena_t const*)vkeys);
+}
+void Test_KeyComparator()
+{
+	char* TEST_STRINGS[] = {
+		"abcde", "a,./,b     c.,.,.de", "ABCDEFGHIJ", "abcdefghi", "abcdefgh",
+		"abcdefghij!", "", ",,,", "Z", "abcdefgh z", "AbCdEfGhIa",
+		"Ёлка", "ёлка!", "Яблоко", "арбуз", "Straße", "STRASSE", "Émile", "emile", "émile",
+		"z\xff\xfez", "zz\xd0", "Łódź", "ŁÓDŹ", "елка", "Ель",
+	};
+	size_t const n = sizeof(TEST_STRINGS) / sizeof(TEST_STRINGS[0]);
+
+	strv_t lines[sizeof(TEST_STRINGS) / sizeof(TEST_STRINGS[0])];
+	for(size_t i = 0; i < n; ++i) {
+		lines[i].pfirst = TEST_STRINGS[i];
+		lines[i].plast = TEST_STRINGS[i] + strlen(TEST_STRINGS[i]);
 	}
-	{
-		char* TEST_STRING1 = "a   b,,,c , , ,de";
-		char* TEST_STRING2 = "a,./,b     c.,.,.de";
-		string_t s1 = { TEST_STRING1, TEST_STRING1 + strlen(TEST_STRING1) };
-		string_t s2 = { TEST_STRING2, TEST_STRING2 + strlen(TEST_STRING2) };
-		TEST_IRV(Comparator(&s1, &s2), 0);
+
+	keyarena_t keys = {};
+	TEST_IRV(keyarena_init(&keys, lines, n, KEYS_FORWARD | KEYS_REVERSE), 1);
+	sortrec_t* recs = sortrec_make(&keys, 0, n);
+	TEST_IRV(recs != NULL, 1);
+	if(recs == NULL) {
+		keyarena_free(&keys);
+		return;
 	}
-	{
-		char* TEST_STRING1 = "z   b,,,c , , ,de";
-		char* TEST_STRING2 = "a,./,b     c.,.,.de";
-		string_t s1 = { TEST_STRING1, TEST_STRING1 + strlen(TEST_STRING1) };
-		string_t s2 = { TEST_STRING2, TEST_STRING2 + strlen(TEST_STRING2) };
-		TEST_IRV(Comparator(&s1, &s2), 1);
+
+	// keys order lines like Comparator, equal lines are ordered by their numbers
+	for(size_t i = 0; i < n; ++i) {
+		for(size_t j = 0; j < n; ++j) {
+			int ref = Comparator(&lines[i], &lines[j]);
+			if(ref == 0)
+				ref = (i > j) - (i < j);
+
+			int const cmp = KeyComparator(&recs[i], &recs[j], &keys);
+			TEST_IRV((cmp > 0) - (cmp < 0), ref);
+		}
 	}
-	{
-		char* TEST_STRING1 = "a   b,,,c , , ,da";
-		char* TEST_STRING2 = "e,./,b     c.,.,.da";
-		string_t s1 = { TEST_STRING1, TEST_STRING1 + strlen(TEST_STRING1) };
-		string_t s2 = { TEST_STRING2, TEST_STRING2 + strlen(TEST_STRING2) };
-		TEST_IRV(Comparator(&s1, &s2), -1);
+
+	// ё sorts as е: "Ёлка" and "елка" are equal, both are before "Ель" and "Яблоко"
+	size_t const yolka = 11, yabloko = 13, elka = n - 2, el = n - 1;
+	TEST_IRV(KeyComparator(&recs[elka], &recs[yolka], &keys) > 0, 1);
+	TEST_IRV(KeyComparator(&recs[yolka], &recs[el], &keys) < 0, 1);
+	TEST_IRV(KeyComparator(&recs[el], &recs[yabloko], &keys) < 0, 1);
+
+	free(recs);
+	keyarena_free(&keys);
+}
+
+void* RunSortTask(void* vtask)
+{
+	SortTask* task = (SortTask*)vtask;
+	task->ok = sortrec_query(task->recs, &task->nrecs, task->keys, task->order, 
+							 &task->opts->query, task->opts->radix, task->nthreads, 
+							 task->counts);
+	return NULL;
+}
+
+static int IntComparator(void const* vi1, void const* vi2, void* unused)
+{
+	(void)unused;
+
+	// only the high bits are compared, so the sort stability is observable
+	int const i1 = *(int const*)vi1 >> 8;
+	int const i2 = *(int const*)vi2 >> 8;
+	return (i1 > i2) - (i1 < i2);
+}
+void Test_psort()
+{
+	size_t const n = 4003;
+	int* const data = (int*)malloc(n * sizeof(int));
+	int* const ref = (int*)malloc(n * sizeof(int));
+	if(data == NULL || ref == NULL) {
+		free(data);
+		free(ref);
+		return;
+	}
+
+	// small runs, so that the array is still sorted by up to 7 threads
+	size_t const min_run = sort_min_run;
+	sort_min_run = 512;
+
+	srand(42);
+	for(size_t nthreads = 1; nthreads <= 7; nthreads += 3) {
+		for(size_t i = 0; i < n; ++i) {
+			data[i] = (rand() % 1000) << 8 | (int)(i % 256);
+		}
+		memcpy(ref, data, n * sizeof(int));
+
+		psort(data, n, sizeof(int), IntComparator, NULL, nthreads);
+
+		// the stable result is known from the counting sort
+		size_t offsets[1001] = {};
+		for(size_t i = 0; i < n; ++i) {
+			++offsets[(ref[i] >> 8) + 1];
+		}
+		for(size_t key = 1; key <= 1000; ++key) {
+			offsets[key] += offsets[key - 1];
+		}
+		int* const stable = (int*)malloc(n * sizeof(int));
+		if(stable == NULL)
+			break;
+		for(size_t i = 0; i < n; ++i) {
+			stable[offsets[ref[i] >> 8]++] = ref[i];
+		}
+
+		TEST_IRV(memcmp(data, stable, n * sizeof(int)) == 0, 1);
+		free(stable);
+	}
+	sort_min_run = min_run;
+
+	free(data);
+	free(ref);
+}
+
+void Test_radix_sort()
+{
+	// long common prefixes, empty keys and duplicates
+	static char const* const WORDS[] = { 
+		"", "a", "ab", "abcdefgh", "abcdefghi", "abcdefghij", "ABCDEFGHIJK", "b", 
+		"abcdefgh, ij", "zz", "z z", "abcdefghijklmnopqrstuvwxyz", "abcdefghijklmnopq",
+	};
+	size_t const nwords = sizeof(WORDS) / sizeof(WORDS[0]);
+	size_t const n = 5000;
+
+	strv_t* const lines = (strv_t*)calloc(n, sizeof(strv_t));
+	if(lines == NULL)
+		return;
+
+	srand(7);
+	for(size_t i = 0; i < n; ++i) {
+		char const* const word = WORDS[(size_t)rand() % nwords];
+		size_t const len = strlen(word);
+		size_t const cut = (size_t)rand() % (len + 1);
+
+		lines[i].pfirst = word;
+		lines[i].plast = word + (rand() % 2 ? len : cut);
+	}
+
+	keyarena_t keys = {};
+	sortrec_t* recs1 = NULL;
+	sortrec_t* recs2 = NULL;
+	if(keyarena_init(&keys, lines, n, KEYS_FORWARD | KEYS_REVERSE) && 
+	   (recs1 = sortrec_make(&keys, 0, 2 * n)) != NULL &&
+	   (recs2 = sortrec_make(&keys, 0, 2 * n)) != NULL) {
+		qsort_r(recs1, 2 * n, sizeof(sortrec_t), KeyComparator, &keys);
+		radix_sort(recs2, 2 * n, &keys);
+		TEST_IRV(memcmp(recs1, recs2, 2 * n * sizeof(sortrec_t)) == 0, 1);
+	}
+
+	free(recs1);
+	free(recs2);
+	keyarena_free(&keys);
+	free(lines);
+}
+
+void Test_sortrec_unique()
+{
+	char* TEST_STRINGS[] = { "a b", "c", "A, B!", "ab", "", "...", "c", "b a" };
+	size_t const n = sizeof(TEST_STRINGS) / sizeof(TEST_STRINGS[0]);
+
+	strv_t lines[sizeof(TEST_STRINGS) / sizeof(TEST_STRINGS[0])];
+	for(size_t i = 0; i < n; ++i) {
+		lines[i].pfirst = TEST_STRINGS[i];
+		lines[i].plast = TEST_STRINGS[i] + strlen(TEST_STRINGS[i]);
+	}
+
+	keyarena_t keys = {};
+	sortrec_t* recs = NULL;
+	if(keyarena_init(&keys, lines, n, KEYS_FORWARD) && 
+	   (recs = sortrec_make(&keys, 0, n)) != NULL) {
+		qsort_r(recs, n, sizeof(sortrec_t), KeyComparator, &keys);
+
+		// "", "..." | "a b", "A, B!", "ab" | "b a" | "c", "c"
+		size_t counts[sizeof(TEST_STRINGS) / sizeof(TEST_STRINGS[0])] = {};
+		TEST_IRV((int)sortrec_unique(recs, n, &keys, counts), 4);
+		TEST_IRV((int)recs[0].index, 4);
+		TEST_IRV((int)counts[0], 2);
+		TEST_IRV((int)recs[1].index, 0);
+		TEST_IRV((int)counts[1], 3);
+		TEST_IRV((int)recs[2].index, 7);
+		TEST_IRV((int)counts[2], 1);
+		TEST_IRV((int)recs[3].index, 1);
+		TEST_IRV((int)counts[3], 2);
+	}
+
+	free(recs);
+	keyarena_free(&keys);
+}
+
+// compares the key k of the arena with the string
+static int KeyStrCompare(keyarena_t const* keys, size_t k, char const* str)
+{
+	size_t const len = keyarena_len(keys, k);
+	size_t const slen = strlen(str);
+
+	int const res = memcmp(keyarena_key(keys, k), str, len < slen ? len : slen);
+	if(res != 0)
+		return res;
+	return (len > slen) - (len < slen);
+}
+void Test_sortrec_top()
+{
+	size_t const n = 3000;
+	strv_t* const lines = (strv_t*)calloc(n, sizeof(strv_t));
+	char* const text = (char*)calloc(n, 4);
+	if(lines == NULL || text == NULL) {
+		free(lines);
+		free(text);
+		return;
+	}
+
+	// many equal keys of 1..3 letters
+	srand(11);
+	for(size_t i = 0; i < n; ++i) {
+		char* const line = text + 4 * i;
+		for(size_t j = 0; j < 3; ++j) {
+			line[j] = (char)('a' + rand() % 6);
+		}
+		lines[i].pfirst = line;
+		lines[i].plast = line + 1 + (size_t)rand() % 3;
+	}
+
+	keyarena_t keys = {};
+	sortrec_t* all = NULL;
+	if(keyarena_init(&keys, lines, n, KEYS_FORWARD) && 
+	   (all = sortrec_make(&keys, 0, n)) != NULL) {
+		qsort_r(all, n, sizeof(sortrec_t), KeyComparator, &keys);
+
+		// the first k records of the full sort
+		size_t const K[] = { 1, 7, 100, n, n + 5 };
+		for(size_t i = 0; i < sizeof(K) / sizeof(K[0]); ++i) {
+			sortrec_t* const recs = sortrec_make(&keys, 0, n);
+			if(recs == NULL)
+				break;
+
+			size_t const ntop = sortrec_top(recs, n, &keys, K[i]);
+			TEST_IRV(ntop == (K[i] < n ? K[i] : n), 1);
+			TEST_IRV(memcmp(recs, all, ntop * sizeof(sortrec_t)) == 0, 1);
+			free(recs);
+		}
+
+		// keys from "bc" to "d": the part of the full sort between them
+		sortrec_t* const recs = sortrec_make(&keys, 0, n);
+		if(recs != NULL) {
+			strv_t const from = { "bc", "bc" + 2 };
+			strv_t const to = { "d", "d" + 1 };
+			size_t const nrange = sortrec_range(recs, n, &keys, &from, &to, NULL);
+			qsort_r(recs, nrange, sizeof(sortrec_t), KeyComparator, &keys);
+
+			size_t first = 0;
+			while(first < n && KeyStrCompare(&keys, all[first].index, "bc") < 0)
+				++first;
+			size_t last = first;
+			while(last < n && KeyStrCompare(&keys, all[last].index, "d") < 0)
+				++last;
+
+			TEST_IRV((int)nrange, (int)(last - first));
+			TEST_IRV(memcmp(recs, all + first, nrange * sizeof(sortrec_t)) == 0, 1);
+			free(recs);
+		}
 	}
+
+	free(all);
+	keyarena_free(&keys);
+	free(lines);
+	free(text);
 }
 
+void Test_index()
+{
+	char const TEST_TEXT[] = "the end\nAnd then\n...\nThe End!\nthee";
+	size_t const size = sizeof(TEST_TEXT) - 1;
+
+	// what index_build() writes for the text: "...", "And then", "thee", "the end",
+	// "The End!" and "...", "the end", "The End!", "thee", "And then" read from the end
+	static uint64_t const FORWARD[] = { 17, 8, 30, 0, 21 };
+	static uint64_t const REVERSE[] = { 17, 0, 21, 30, 8 };
+	index_t const index = { .nlines = 5, .offsets = { FORWARD, REVERSE } };
+
+	strv_t line = index_line(&index, KEYS_FORWARD, TEST_TEXT, size, 1);
+	TEST_IRV((int)(line.plast - line.pfirst), 8);
+	TEST_IRV(memcmp(line.pfirst, "And then", 8), 0);
+	line = index_line(&index, KEYS_FORWARD, TEST_TEXT, size, 2);
+	TEST_IRV((int)(line.plast - line.pfirst), 4);
+
+	size_t first = 0;
+	size_t last = 0;
+	sortquery_t query = { .prefix = "THE" };
+	TEST_IRV(index_range(&index, KEYS_FORWARD, TEST_TEXT, size, &query, &first, &last),
+			 INDEX_ERR_OK);
+	TEST_IRV((int)first, 2);
+	TEST_IRV((int)last, 5);
+
+	query = (sortquery_t){ .prefix = "n", .from = "the end" };
+	TEST_IRV(index_range(&index, KEYS_REVERSE, TEST_TEXT, size, &query, &first, &last),
+			 INDEX_ERR_OK);
+	TEST_IRV((int)first, 4);
+	TEST_IRV((int)last, 5);
+}
@@ -0,0 +1,516 @@
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <ttrack/dbg.h>
+
+#include "sort.h"
+
+/// Runs shorter than this are not worth a thread.
+#define SORT__MIN_RUN (1 << 14)
+
+#ifdef TESTS
+size_t sort_min_run = SORT__MIN_RUN;
+#else
+#	define sort_min_run ((size_t)SORT__MIN_RUN)
+#endif /* TESTS */
+
+typedef struct {
+	char* src;
+	char* dst;
+	size_t size;
+	sort_cmp_t cmp;
+	void* arg;
+
+	size_t nmemb;
+	size_t* bounds;	///< nruns + 1 run boundaries
+	size_t nruns;
+	size_t nworkers;
+} sort__job_t;
+
+typedef struct {
+	pthread_t thread;
+	int started;
+	sort__job_t* job;
+	size_t id;
+} sort__worker_t;
+
+static void* sort__worker_sort(void* const data)
+{
+	sort__worker_t* const worker = (sort__worker_t*)data;
+	sort__job_t* const job = worker->job;
+
+	size_t const first = job->bounds[worker->id];
+	size_t const last = job->bounds[worker->id + 1];
+	qsort_r(job->src + first * job->size, last - first, job->size, job->cmp, job->arg);
+	return NULL;
+}
+
+/*
+ * Number of elements of a taken into the first k elements of the stable merge
+ * of a and b.
+ */
+static size_t sort__corank(sort__job_t const* const job, size_t const k, 
+						   char const* const a, size_t const na, 
+						   char const* const b, size_t const nb)
+{
+	size_t lo = k > nb ? k - nb : 0;
+	size_t hi = k < na ? k : na;
+
+	while(lo < hi) {
+		size_t const mid = lo + (hi - lo) / 2;
+		if(job->cmp(a + mid * job->size, b + (k - mid - 1) * job->size, job->arg) <= 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/*
+ * Every merge round is shared by output positions: each worker produces the same
+ * part of the output, whichever pairs of runs it falls in.
+ */
+static void* sort__worker_merge(void* const data)
+{
+	sort__worker_t* const worker = (sort__worker_t*)data;
+	sort__job_t* const job = worker->job;
+	size_t const size = job->size;
+
+	size_t const lo = job->nmemb * worker->id / job->nworkers;
+	size_t const hi = job->nmemb * (worker->id + 1) / job->nworkers;
+
+	for(size_t run = 0; run < job->nruns; run += 2) {
+		size_t const first = job->bounds[run];
+		size_t const middle = job->bounds[run + 1];
+		size_t const last = run + 1 < job->nruns ? job->bounds[run + 2] : middle;
+
+		size_t const begin = lo > first ? lo : first;
+		size_t const end = hi < last ? hi : last;
+		if(begin >= end) {
+			continue;
+		}
+
+		char const* const a = job->src + first * size;
+		char const* const b = job->src + middle * size;
+		size_t const na = middle - first;
+		size_t const nb = last - middle;
+
+		size_t i = sort__corank(job, begin - first, a, na, b, nb);
+		size_t j = begin - first - i;
+		size_t const iend = sort__corank(job, end - first, a, na, b, nb);
+		size_t const jend = end - first - iend;
+
+		char* out = job->dst + begin * size;
+		while(i < iend && j < jend) {
+			if(job->cmp(a + i * size, b + j * size, job->arg) <= 0) {
+				memcpy(out, a + i++ * size, size);
+			} else {
+				memcpy(out, b + j++ * size, size);
+			}
+			out += size;
+		}
+		memcpy(out, a + i * size, (iend - i) * size);
+		out += (iend - i) * size;
+		memcpy(out, b + j * size, (jend - j) * size);
+	}
+	return NULL;
+}
+
+// runs fn for every worker, the calling thread runs the first one and the ones
+// whose threads failed to start
+static void sort__run_workers(sort__worker_t* const workers, size_t const nworkers,
+							  void* (*fn)(void*))
+{
+	for(size_t i = 1; i < nworkers; ++i) {
+		workers[i].started = pthread_create(&workers[i].thread, NULL, fn, 
+											&workers[i]) == 0;
+	}
+	for(size_t i = 0; i < nworkers; ++i) {
+		if(i == 0 || !workers[i].started) {
+			fn(&workers[i]);
+		}
+	}
+	for(size_t i = 1; i < nworkers; ++i) {
+		if(workers[i].started) {
+			pthread_join(workers[i].thread, NULL);
+		}
+	}
+}
+
+void psort(void* const base, size_t const nmemb, size_t const size, 
+		   sort_cmp_t const cmp, void* const arg, size_t nthreads)
+{$_
+	ASSERT(base != NULL || nmemb == 0);
+	ASSERT(cmp != NULL);
+
+	if(nthreads == 0) {
+		long const ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = ncpus > 0 ? (size_t)ncpus : 1;
+	}
+	if(nthreads > nmemb / sort_min_run) {
+		nthreads = nmemb / sort_min_run;
+	}
+
+	char* const buffer = nthreads > 1 ? (char*)malloc(nmemb * size) : NULL;
+	size_t* const bounds = (size_t*)malloc((nthreads + 1) * sizeof(size_t));
+	sort__worker_t* const workers = (sort__worker_t*)calloc(nthreads + 1, 
+															sizeof(sort__worker_t));
+	if(buffer == NULL || bounds == NULL || workers == NULL) {
+		free(buffer);
+		free(bounds);
+		free(workers);
+
+		qsort_r(base, nmemb, size, cmp, arg);
+		RETURN();
+	}
+
+	sort__job_t job = { (char*)base, buffer, size, cmp, arg, 
+						nmemb, bounds, nthreads, nthreads };
+	for(size_t i = 0; i <= nthreads; ++i) {
+		bounds[i] = nmemb * i / nthreads;
+	}
+	for(size_t i = 0; i < nthreads; ++i) {
+		workers[i].job = &job;
+		workers[i].id = i;
+	}
+
+	sort__run_workers(workers, nthreads, sort__worker_sort);
+
+	while(job.nruns > 1) {
+		sort__run_workers(workers, nthreads, sort__worker_merge);
+
+		// boundaries of the merged runs are every second old boundary
+		size_t nruns = 0;
+		for(size_t i = 0; i < job.nruns; i += 2) {
+			bounds[nruns++] = bounds[i];
+		}
+		bounds[nruns] = nmemb;
+		job.nruns = nruns;
+
+		char* const tmp = job.src;
+		job.src = job.dst;
+		job.dst = tmp;
+	}
+
+	if(job.src != (char*)base) {
+		memcpy(base, job.src, nmemb * size);
+	}
+
+	free(buffer);
+	free(bounds);
+	free(workers);
+$$
+}
+
+/// Buckets not larger than this are sorted by insertion.
+#define SORT__RADIX_CUTOFF 32
+
+typedef struct {
+	size_t first;
+	size_t last;
+	size_t depth;
+} sort__bucket_t;
+
+int sortrec_qcmp(void const* const vr1, void const* const vr2, void* const vkeys)
+{
+	return sortrec_cmp((sortrec_t const*)vr1, (sortrec_t const*)vr2, 
+					   (keyarena_t const*)vkeys);
+}
+
+// key byte at depth, 0 past the end of the key
+static inline unsigned sort__digit(sortrec_t const* const rec, size_t const depth,
+								   keyarena_t const* const keys)
+{
+	if(depth < SORTREC_PREFIX_SIZE) {
+		return (unsigned)(rec->prefix >> (8 * (SORTREC_PREFIX_SIZE - 1 - depth))) & 0xff;
+	}
+	return depth < rec->len ? (unsigned char)keyarena_key(keys, rec->index)[depth] : 0;
+}
+
+static void sort__insertion(sortrec_t* const recs, size_t const nrecs, 
+							keyarena_t const* const keys)
+{
+	for(size_t i = 1; i < nrecs; ++i) {
+		sortrec_t const rec = recs[i];
+
+		size_t j = i;
+		for(; j > 0 && sortrec_cmp(&rec, &recs[j - 1], keys) < 0; --j) {
+			recs[j] = recs[j - 1];
+		}
+		recs[j] = rec;
+	}
+}
+
+void radix_sort(sortrec_t* const recs, size_t const nrecs, keyarena_t const* const keys)
+{$_
+	ASSERT(recs != NULL || nrecs == 0);
+	ASSERT(keys != NULL);
+
+	size_t capacity = 256;
+	sortrec_t* const buffer = (sortrec_t*)malloc(nrecs * sizeof(sortrec_t) + 1);
+	sort__bucket_t* stack = (sort__bucket_t*)malloc(capacity * sizeof(sort__bucket_t));
+	if(buffer == NULL || stack == NULL) {
+		free(buffer);
+		free(stack);
+
+		qsort_r(recs, nrecs, sizeof(sortrec_t), sortrec_qcmp, (void*)keys);
+		RETURN();
+	}
+
+	size_t nbuckets = 0;
+	stack[nbuckets++] = (sort__bucket_t){ 0, nrecs, 0 };
+
+	while(nbuckets > 0) {
+		sort__bucket_t const bucket = stack[--nbuckets];
+		sortrec_t* const first = recs + bucket.first;
+		size_t const size = bucket.last - bucket.first;
+
+		if(size <= SORT__RADIX_CUTOFF) {
+			sort__insertion(first, size, keys);
+			continue;
+		}
+
+		size_t offsets[257] = {};
+		for(size_t i = 0; i < size; ++i) {
+			++offsets[sort__digit(&first[i], bucket.depth, keys) + 1];
+		}
+
+		// the whole bucket shares the byte: go deeper without moving anything
+		unsigned const digit = sort__digit(&first[0], bucket.depth, keys);
+		if(digit != 0 && offsets[digit + 1] == size) {
+			stack[nbuckets++] = (sort__bucket_t){ bucket.first, bucket.last, 
+												  bucket.depth + 1 };
+			continue;
+		}
+
+		for(size_t d = 1; d <= 256; ++d) {
+			offsets[d] += offsets[d - 1];
+		}
+
+		// stable distribution, offsets[d] ends up at the end of the bucket d
+		for(size_t i = 0; i < size; ++i) {
+			buffer[offsets[sort__digit(&first[i], bucket.depth, keys)]++] = first[i];
+		}
+		memcpy(first, buffer, size * sizeof(sortrec_t));
+
+		// ended keys are all equal, so only their line numbers are to be ordered
+		for(size_t i = 1; i < offsets[0]; ++i) {
+			if(first[i - 1].index > first[i].index) {
+				qsort_r(first, offsets[0], sizeof(sortrec_t), sortrec_qcmp, (void*)keys);
+				break;
+			}
+		}
+
+		if(nbuckets + 255 > capacity) {
+			sort__bucket_t* const new_stack = (sort__bucket_t*)realloc(stack, 
+											  2 * capacity * sizeof(sort__bucket_t));
+			if(new_stack == NULL) {
+				qsort_r(first + offsets[0], size - offsets[0], sizeof(sortrec_t), 
+						sortrec_qcmp, (void*)keys);
+				continue;
+			}
+			stack = new_stack;
+			capacity *= 2;
+		}
+
+		for(size_t d = 1; d < 256; ++d) {
+			if(offsets[d] - offsets[d - 1] > 1) {
+				stack[nbuckets++] = (sort__bucket_t){ bucket.first + offsets[d - 1], 
+													  bucket.first + offsets[d], 
+													  bucket.depth + 1 };
+			}
+		}
+	}
+
+	free(buffer);
+	free(stack);
+$$
+}
+
+size_t const sortrec_unique(sortrec_t* const recs, size_t const nrecs, 
+							keyarena_t const* const keys, size_t* const counts)
+{$_
+	ASSERT(recs != NULL || nrecs == 0);
+	ASSERT(keys != NULL);
+
+	size_t nunique = 0;
+	for(size_t first = 0; first < nrecs; ) {
+		size_t last = first + 1;
+		while(last < nrecs && sortrec_keyeq(&recs[first], &recs[last], keys)) {
+			++last;
+		}
+
+		if(counts != NULL) {
+			counts[nunique] = last - first;
+		}
+		recs[nunique++] = recs[first];
+		first = last;
+	}
+
+	RETURN(nunique);
+}
+
+static void sort__sift_down(sortrec_t* const heap, size_t const size, size_t node,
+							keyarena_t const* const keys)
+{
+	sortrec_t const rec = heap[node];
+	for(;;) {
+		size_t child = 2 * node + 1;
+		if(child >= size) {
+			break;
+		}
+		if(child + 1 < size && sortrec_cmp(&heap[child], &heap[child + 1], keys) < 0) {
+			++child;
+		}
+		if(sortrec_cmp(&rec, &heap[child], keys) >= 0) {
+			break;
+		}
+
+		heap[node] = heap[child];
+		node = child;
+	}
+	heap[node] = rec;
+}
+
+size_t const sortrec_top(sortrec_t* const recs, size_t const nrecs, 
+						 keyarena_t const* const keys, size_t const k)
+{$_
+	ASSERT(recs != NULL || nrecs == 0);
+	ASSERT(keys != NULL);
+
+	size_t const size = k < nrecs ? k : nrecs;
+	if(size == 0) {
+		RETURN(0);
+	}
+
+	// max-heap of the first records found so far
+	for(size_t node = size / 2; node > 0; --node) {
+		sort__sift_down(recs, size, node - 1, keys);
+	}
+	for(size_t i = size; i < nrecs; ++i) {
+		if(sortrec_cmp(&recs[i], &recs[0], keys) < 0) {
+			recs[0] = recs[i];
+			sort__sift_down(recs, size, 0, keys);
+		}
+	}
+
+	for(size_t last = size - 1; last > 0; --last) {
+		sortrec_t const max = recs[0];
+		recs[0] = recs[last];
+		recs[last] = max;
+		sort__sift_down(recs, last, 0, keys);
+	}
+
+	RETURN(size);
+}
+
+// compares the key of the record with the key
+static int sort__keycmp(sortrec_t const* const rec, keyarena_t const* const keys, 
+						strv_t const* const key)
+{
+	size_t const keylen = (size_t)(key->plast - key->pfirst);
+	size_t const len = rec->len < keylen ? rec->len : keylen;
+
+	int const res = memcmp(keyarena_key(keys, rec->index), key->pfirst, len);
+	if(res != 0) {
+		return res;
+	}
+	return (rec->len > keylen) - (rec->len < keylen);
+}
+
+size_t const sortrec_range(sortrec_t* const recs, size_t const nrecs, 
+						   keyarena_t const* const keys, strv_t const* const from,
+						   strv_t const* const to, strv_t const* const prefix)
+{$_
+	ASSERT(recs != NULL || nrecs == 0);
+	ASSERT(keys != NULL);
+
+	size_t const prefixlen = prefix != NULL ? (size_t)(prefix->plast - prefix->pfirst) : 0;
+
+	size_t nleft = 0;
+	for(size_t i = 0; i < nrecs; ++i) {
+		if((from == NULL || sort__keycmp(&recs[i], keys, from) >= 0) &&
+		   (to == NULL || sort__keycmp(&recs[i], keys, to) < 0) &&
+		   (prefix == NULL || (recs[i].len >= prefixlen && 
+							   memcmp(keyarena_key(keys, recs[i].index), prefix->pfirst, 
+									  prefixlen) == 0))) {
+			recs[nleft++] = recs[i];
+		}
+	}
+
+	RETURN(nleft);
+}
+
+int const sortquery_keys(sortquery_t const* const query, keyorder_t const order, 
+						 keyarena_t* const keys)
+{$_
+	ASSERT(query != NULL);
+	ASSERT(keys != NULL);
+
+	// bounds get their keys like lines
+	char const* const from = query->from != NULL ? query->from : "";
+	char const* const to = query->to != NULL ? query->to : "";
+	char const* const prefix = query->prefix != NULL ? query->prefix : "";
+	strv_t const bounds[] = { 
+		{ from, from + strlen(from) }, 
+		{ to, to + strlen(to) },
+		{ prefix, prefix + strlen(prefix) },
+	};
+
+	RETURN(keyarena_init(keys, bounds, 3, order));
+}
+
+int const sortrec_query(sortrec_t* const recs, size_t* const pnrecs, 
+						keyarena_t const* const keys, keyorder_t const order, 
+						sortquery_t const* const query, int const radix, 
+						size_t const nthreads, size_t* const counts)
+{$_
+	ASSERT(recs != NULL || *pnrecs == 0);
+	ASSERT(pnrecs != NULL);
+	ASSERT(keys != NULL);
+	ASSERT(query != NULL);
+
+	size_t nrecs = *pnrecs;
+
+	if(query->from != NULL || query->to != NULL || query->prefix != NULL) {
+		keyarena_t bkeys = {};
+		if(!sortquery_keys(query, order, &bkeys)) {
+			RETURN(0);
+		}
+
+		strv_t bounds[3] = {};
+		for(size_t i = 0; i < 3; ++i) {
+			bounds[i].pfirst = keyarena_key(&bkeys, i);
+			bounds[i].plast = keyarena_key(&bkeys, i) + keyarena_len(&bkeys, i);
+		}
+		nrecs = sortrec_range(recs, nrecs, keys, query->from != NULL ? &bounds[0] : NULL,
+							  query->to != NULL ? &bounds[1] : NULL, 
+							  query->prefix != NULL ? &bounds[2] : NULL);
+		keyarena_free(&bkeys);
+	}
+
+	if(query->top != 0 && query->unique == UNIQUE_NONE) {
+		nrecs = sortrec_top(recs, nrecs, keys, query->top);
+	} else {
+		if(radix) {
+			radix_sort(recs, nrecs, keys);
+		} else {
+			psort(recs, nrecs, sizeof(sortrec_t), sortrec_qcmp, (void*)keys, nthreads);
+		}
+
+		if(query->unique != UNIQUE_NONE) {
+			nrecs = sortrec_unique(recs, nrecs, keys, counts);
+		}
+		if(query->top != 0 && nrecs > query->top) {
+			nrecs = query->top;
+		}
+	}
+
+	*pnrecs = nrecs;
+	RETURN(1);
+}
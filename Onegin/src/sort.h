@@ -0,0 +1,128 @@
+#ifndef ONEGIN_SORT_H
+#define ONEGIN_SORT_H
+
+#ifdef __GNUC__
+#	pragma GCC diagnostic ignored "-Wignored-qualifiers"
+#endif /* __GNUC__ */
+
+#include <stddef.h>
+
+#include "collate.h"
+
+/// Comparator in the qsort_r() form.
+typedef int (*sort_cmp_t)(void const*, void const*, void*);
+
+/**
+ * \brief Sorts the array using several threads.
+ *
+ * The array is divided into one run per thread, the runs are sorted in parallel,
+ * then merged pairwise, each merge round being shared by all threads. Merges are
+ * stable, so a comparator that defines a total order gives the same result as
+ * qsort_r() for any number of threads.
+ *
+ * \param[in] nthreads number of threads, 0 for the number of processors. Small
+ * 		arrays are sorted by fewer threads.
+ *
+ * Falls back to qsort_r() if there is not enough memory for the merge buffer.
+ */
+void psort(void* const base, size_t const nmemb, size_t const size, 
+		   sort_cmp_t const cmp, void* const arg, size_t nthreads);
+
+#ifdef TESTS
+/// Shortest run psort() gives a thread. Lowered by the tests to sort small arrays in parallel.
+extern size_t sort_min_run;
+#endif /* TESTS */
+
+/// sortrec_cmp() in the sort_cmp_t form, the argument is the key arena.
+int sortrec_qcmp(void const* const vr1, void const* const vr2, void* const vkeys);
+
+/**
+ * \brief Sorts the records by MSD radix sort, in the sortrec_cmp() order.
+ *
+ * Records are distributed by key bytes, the first SORTREC_PREFIX_SIZE of which
+ * are read from the records themselves; small buckets are finished by insertion
+ * sort. Single-threaded.
+ *
+ * Falls back to qsort_r() if there is not enough memory.
+ */
+void radix_sort(sortrec_t* const recs, size_t const nrecs, keyarena_t const* const keys);
+
+/// How sorted lines with equal keys are output.
+typedef enum {
+	UNIQUE_NONE = 0,	///< all of them
+	UNIQUE_FIRST,		///< only the first one
+	UNIQUE_COUNT,		///< only the first one, prefixed by their number
+} unique_t;
+
+/// Format of the number of lines UNIQUE_COUNT prints before the line, like uniq -c.
+#define UNIQUE_COUNT_FORMAT "%7zu "
+
+/**
+ * \brief Leaves only the first record of every group of records with equal keys in
+ * the sorted array.
+ *
+ * \param[out] counts sizes of the groups, nrecs elements. May be NULL.
+ * \return number of records left.
+ */
+size_t const sortrec_unique(sortrec_t* const recs, size_t const nrecs, 
+							keyarena_t const* const keys, size_t* const counts);
+
+/**
+ * \brief Leaves only the first k records in the sortrec_cmp() order and sorts them.
+ *
+ * Keeps a heap of k records, so takes O(n log k) comparisons.
+ *
+ * \return number of records left, min(k, nrecs).
+ */
+size_t const sortrec_top(sortrec_t* const recs, size_t const nrecs, 
+						 keyarena_t const* const keys, size_t const k);
+
+/**
+ * \brief Leaves only the records with keys from the key from (inclusive) to the
+ * key to (exclusive) that start with the key prefix. Any of them may be NULL.
+ * The order of records is kept.
+ *
+ * \return number of records left.
+ */
+size_t const sortrec_range(sortrec_t* const recs, size_t const nrecs, 
+						   keyarena_t const* const keys, strv_t const* const from,
+						   strv_t const* const to, strv_t const* const prefix);
+
+/// Part of the sorted lines to be output.
+typedef struct {
+	unique_t unique;	///< what to do with lines with equal keys
+	size_t top;			///< only the first lines (after collapsing), 0 for all
+	char const* from;	///< only lines sorted not before this one, NULL for no bound
+	char const* to;		///< only lines sorted before this one, NULL for no bound
+	char const* prefix;	///< only lines whose keys start with the key of this one or NULL
+} sortquery_t;
+
+/**
+ * \brief Builds keys of the query from, to and prefix (keys 0, 1 and 2; empty if
+ * NULL) in the order.
+ *
+ * \return 1 in case of success, 0 if malloc() failed.
+ */
+int const sortquery_keys(sortquery_t const* const query, keyorder_t const order, 
+						 keyarena_t* const keys);
+
+/**
+ * \brief Sorts records of keys of one order and leaves only the query.
+ *
+ * Bounds and prefix are compared the way lines are, so for KEYS_REVERSE they are
+ * read from the end too: the prefix selects lines ending with it. Lines out of the
+ * range are dropped before sorting. The top lines are selected by sortrec_top() if
+ * there is nothing to collapse.
+ *
+ * \param[in, out] pnrecs number of records, then number of records left.
+ * \param[in] radix sort by radix_sort(), by psort() otherwise.
+ * \param[in] nthreads threads of psort().
+ * \param[out] counts for collapsed records the numbers of lines. May be NULL.
+ * \return 1 in case of success, 0 if malloc() failed.
+ */
+int const sortrec_query(sortrec_t* const recs, size_t* const pnrecs, 
+						keyarena_t const* const keys, keyorder_t const order, 
+						sortquery_t const* const query, int const radix, 
+						size_t const nthreads, size_t* const counts);
+
+#endif /* ONEGIN_SORT_H */
@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "corpus.h"
+
+char const* const CORPUS_LINES_NAMES[CORPUS_NLINES] = { "short", "long", "mixed" };
+char const* const CORPUS_ALPHABET_NAMES[CORPUS_NALPHABETS] = { "latin", "cyrillic" };
+
+static char const* const CORPUS__LATIN[] = {
+	"to", "be", "or", "not", "that", "is", "the", "question", "whether", "tis",
+	"nobler", "in", "mind", "suffer", "slings", "and", "arrows", "of", "outrageous",
+	"fortune", "take", "arms", "against", "a", "sea", "troubles", "by", "opposing",
+	"end", "them", "die", "sleep", "no", "more",
+};
+
+static char const* const CORPUS__CYRILLIC[] = {
+	"мой", "дядя", "самых", "честных", "правил", "когда", "не", "в", "шутку",
+	"занемог", "он", "уважать", "себя", "заставил", "и", "лучше", "выдумать", "мог",
+	"его", "пример", "другим", "наука", "но", "боже", "какая", "скука", "с",
+	"больным", "сидеть", "день", "ночь", "отходя", "ни", "шагу", "прочь", "ещё",
+};
+
+static char const CORPUS__PUNCT[] = ",.;:!?-'";
+
+/// Longest line kept for repeating; longer ones are never repeated.
+#define CORPUS__SLOT 4096
+/// Number of recent lines kept for repeating.
+#define CORPUS__NSLOTS 1024
+
+/// xorshift64*: fast, and the same on every platform unlike rand().
+static uint64_t corpus__next(uint64_t* const state)
+{
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+/// Uniform number in [0, 1).
+static double corpus__uniform(uint64_t* const state)
+{
+	return (double)(corpus__next(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/// Copies the word with its first letter uppercased, returns the end of the copy.
+static char* corpus__capitalize(char* out, char const* const word)
+{
+	unsigned char const* const ch = (unsigned char const*)word;
+	size_t skip = 1;
+
+	if('a' <= ch[0] && ch[0] <= 'z') {
+		*out++ = (char)(ch[0] - 'a' + 'A');
+	} else if(ch[0] == 0xD0 && 0xB0 <= ch[1] && ch[1] <= 0xBF) {
+		// а..п
+		*out++ = (char)0xD0;
+		*out++ = (char)(ch[1] - 0x20);
+		skip = 2;
+	} else if(ch[0] == 0xD1 && 0x80 <= ch[1] && ch[1] <= 0x8F) {
+		// р..я
+		*out++ = (char)0xD0;
+		*out++ = (char)(ch[1] + 0x20);
+		skip = 2;
+	} else if(ch[0] == 0xD1 && ch[1] == 0x91) {
+		// ё
+		*out++ = (char)0xD0;
+		*out++ = (char)0x81;
+		skip = 2;
+	} else {
+		skip = 0;
+	}
+
+	size_t const len = strlen(word + skip);
+	memcpy(out, word + skip, len);
+	return out + len;
+}
+
+/// Generates a line of words without '\n', returns its end.
+static char* corpus__line(char* out, corpus_params_t const* const params,
+						  uint64_t* const state)
+{
+	char const* const* const words = params->alphabet == CORPUS_CYRILLIC ?
+									 CORPUS__CYRILLIC : CORPUS__LATIN;
+	size_t const nwords = params->alphabet == CORPUS_CYRILLIC ?
+						  sizeof(CORPUS__CYRILLIC) / sizeof(CORPUS__CYRILLIC[0]) :
+						  sizeof(CORPUS__LATIN) / sizeof(CORPUS__LATIN[0]);
+
+	int const longline = params->lines == CORPUS_LINES_LONG ||
+						 (params->lines == CORPUS_LINES_MIXED &&
+						  corpus__next(state) % 16 == 0);
+	size_t const nline = longline ? 20 + corpus__next(state) % 180 :
+									corpus__next(state) % 12;
+
+	for(size_t i = 0; i < nline; ++i) {
+		char const* const word = words[corpus__next(state) % nwords];
+		if(corpus__next(state) % 8 == 0) {
+			out = corpus__capitalize(out, word);
+		} else {
+			size_t const len = strlen(word);
+			memcpy(out, word, len);
+			out += len;
+		}
+
+		if(corpus__uniform(state) < params->punct)
+			*out++ = CORPUS__PUNCT[corpus__next(state) % (sizeof(CORPUS__PUNCT) - 1)];
+		if(i + 1 < nline)
+			*out++ = ' ';
+	}
+	return out;
+}
+
+int corpus_write(FILE* const file, corpus_params_t const* const params)
+{
+	// the longest line: 199 words of up to 16 bytes, a mark and a space after each
+	char line[199 * 18 + 1];
+
+	// recent lines to repeat, the slot i holds slotlen[i] bytes
+	char* slots = NULL;
+	size_t slotlen[CORPUS__NSLOTS] = {};
+	size_t nslots = 0;
+	if(params->dup > 0 && (slots = (char*)malloc(CORPUS__SLOT * CORPUS__NSLOTS)) == NULL) {
+		return 0;
+	}
+
+	uint64_t state = params->seed * 2 + 1;
+	size_t written = 0;
+	int ok = 1;
+	while(ok) {
+		char const* first = line;
+		size_t len = 0;
+
+		if(nslots > 0 && corpus__uniform(&state) < params->dup) {
+			size_t const slot = corpus__next(&state) % nslots;
+			first = slots + slot * CORPUS__SLOT;
+			len = slotlen[slot];
+		} else {
+			len = (size_t)(corpus__line(line, params, &state) - line);
+
+			if(slots != NULL && len <= CORPUS__SLOT) {
+				size_t const slot = nslots < CORPUS__NSLOTS ? nslots++ :
+									corpus__next(&state) % CORPUS__NSLOTS;
+				memcpy(slots + slot * CORPUS__SLOT, line, len);
+				slotlen[slot] = len;
+			}
+		}
+
+		if(written + len + 1 > params->size)
+			break;
+
+		ok = fwrite(first, sizeof(char), len, file) == len && fputc('\n', file) != EOF;
+		written += len + 1;
+	}
+
+	free(slots);
+	return ok && fflush(file) == 0;
+}
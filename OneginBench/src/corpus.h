@@ -0,0 +1,47 @@
+#ifndef ONEGINBENCH_CORPUS_H
+#define ONEGINBENCH_CORPUS_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/// Distributions of line lengths.
+typedef enum {
+	CORPUS_LINES_SHORT = 0,	///< 0..11 words, like verse
+	CORPUS_LINES_LONG,		///< 20..199 words, like paragraphs of prose
+	CORPUS_LINES_MIXED,		///< short lines, every 16th line on average is long
+
+	CORPUS_NLINES
+} corpus_lines_t;
+
+/// Words of the corpus.
+typedef enum {
+	CORPUS_LATIN = 0,		///< English, ASCII only
+	CORPUS_CYRILLIC,		///< Russian, two bytes per letter in UTF-8
+
+	CORPUS_NALPHABETS
+} corpus_alphabet_t;
+
+/// Names of the distributions and alphabets, as accepted by the command line.
+extern char const* const CORPUS_LINES_NAMES[CORPUS_NLINES];
+extern char const* const CORPUS_ALPHABET_NAMES[CORPUS_NALPHABETS];
+
+/// What corpus_write() generates.
+typedef struct {
+	size_t size;				///< size in bytes; the line that doesn't fit is dropped
+	corpus_lines_t lines;
+	double dup;					///< share of lines repeating one of the recent lines
+	double punct;				///< probability of a punctuation mark after a word
+	corpus_alphabet_t alphabet;
+	unsigned long long seed;	///< the same seed gives the same corpus
+} corpus_params_t;
+
+/**
+ * \brief Writes a random text of lines of words to the stream. Every word is
+ * capitalized with probability 1/8. The text is generated line by line, so its size
+ * is not limited by memory.
+ *
+ * \return 1 in case of success, 0 if writing failed.
+ */
+int corpus_write(FILE* const file, corpus_params_t const* const params);
+
+#endif /* ONEGINBENCH_CORPUS_H */
@@ -0,0 +1,719 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include <ttrack/text.h>
+
+#include "collate.h"
+#include "sort.h"
+#include "extsort.h"
+#include "corpus.h"
+
+/*
+ * Measures Onegin sorting engines on generated corpora or on a given file. Every
+ * engine runs in its own process from the corpus file to the sorted order, so its
+ * time includes splitting lines and building keys, and its peak RSS is its own.
+ * Outputs of engines of the same mode are checked to be identical.
+ */
+
+static char const USAGE[] =
+	"usage: oneginbench [options] [size[K|M|G]]...\n"
+	"Measures Onegin sorting engines on generated corpora of the sizes (1M, 16M and\n"
+	"256M by default).\n"
+	"\n"
+	"  -l, --lines=short|long|mixed   line lengths, short by default\n"
+	"  -d, --dup=SHARE                share of repeated lines, 0 by default\n"
+	"  -p, --punct=PROB               probability of punctuation after a word, 0.17\n"
+	"  -a, --alphabet=latin|cyrillic  words of the corpus, latin by default\n"
+	"  -s, --seed=N                   seed of the corpus\n"
+	"  -c, --corpus=FILE              only write the corpus of the first size to FILE\n"
+	"  -i, --input=FILE               measure on the file instead of corpora\n"
+	"  -e, --engines=LIST             comma separated groups: lines, keys, qsort,\n"
+	"                                 psort, radix, reverse, unique, top, extsort;\n"
+	"                                 all by default\n"
+	"  -t, --threads=N                psort on 1, 2, 4.. N threads, the number of\n"
+	"                                 processors by default\n"
+	"  -m, --mem=SIZE[K|M|G]          memory limit of extsort, 64M by default\n"
+	"  -h, --help                     print this message\n";
+
+/// Lines kept by the top engine.
+#define BENCH_TOP_LINES 1000
+
+/// What engines write, outputs of the same mode must be identical.
+typedef enum {
+	BENCH_NONE = 0,		///< nothing, or an order that can't be compared
+	BENCH_SORT,
+	BENCH_REVERSE,
+	BENCH_UNIQUE,
+	BENCH_TOP,
+
+	BENCH_NMODES
+} bench_mode_t;
+
+/// Command line options.
+typedef struct {
+	corpus_params_t corpus;
+	char const* corpus_file;
+	char const* input;
+	char const* engines;
+	size_t max_threads;
+	size_t mem;
+} bench_options_t;
+
+/// What an engine reports to the parent.
+typedef struct {
+	int ok;
+	double time;
+	uint64_t ncmp;		///< number of comparisons, UINT64_MAX if not counted
+	uint64_t checksum;	///< hash of the output lines
+} bench_result_t;
+
+typedef struct {
+	FILE* corpus;
+	size_t nlines;		///< lines of the corpus, the rates are given in them
+	bench_options_t const* opts;
+} bench_ctx_t;
+
+typedef int (*bench_fn_t)(bench_ctx_t const* ctx, size_t param, bench_result_t* res);
+
+typedef struct {
+	char const* group;
+	char const* name;
+	bench_fn_t run;
+	size_t param;
+	bench_mode_t mode;
+} bench_engine_t;
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/// Parses a size in bytes with an optional K, M or G suffix. Returns 0 if invalid.
+static size_t parse_size(char const* const str)
+{
+	char* end = NULL;
+	unsigned long long const size = strtoull(str, &end, 10);
+	if(end == str)
+		return 0;
+
+	unsigned shift = 0;
+	switch(*end) {
+	case 'K': case 'k': shift = 10; ++end; break;
+	case 'M': case 'm': shift = 20; ++end; break;
+	case 'G': case 'g': shift = 30; ++end; break;
+	}
+	if(*end != '\0' || size > (SIZE_MAX >> shift))
+		return 0;
+	return (size_t)size << shift;
+}
+
+/// Finds the name in the list of names, returns -1 if it isn't there.
+static int parse_name(char const* const str, char const* const* const names, int const n)
+{
+	for(int i = 0; i < n; ++i) {
+		if(strcmp(str, names[i]) == 0)
+			return i;
+	}
+	return -1;
+}
+
+/// Parses a share in [0, 1]. Returns 0 if invalid.
+static int parse_share(char const* const str, double* const share)
+{
+	char* end = NULL;
+	*share = strtod(str, &end);
+	return end != str && *end == '\0' && 0 <= *share && *share <= 1;
+}
+
+/*
+ * Comparisons are counted by the comparators themselves. psort() calls them from
+ * several threads, so each thread counts in its own variable and adds it to
+ * bench__ncmp on exit: a shared counter would put every comparison of every thread
+ * on one cache line.
+ */
+static uint64_t bench__ncmp = 0;
+static _Thread_local uint64_t bench__thread_ncmp = 0;
+
+static pthread_once_t bench__ncmp_once = PTHREAD_ONCE_INIT;
+static pthread_key_t bench__ncmp_key;
+
+static void ncmp_exit(void* const vncmp)
+{
+	__atomic_fetch_add(&bench__ncmp, *(uint64_t const*)vncmp, __ATOMIC_RELAXED);
+}
+
+static void ncmp_init()
+{
+	pthread_key_create(&bench__ncmp_key, ncmp_exit);
+}
+
+static inline void ncmp_count()
+{
+	// the first comparison of the thread makes it report its count on exit
+	if(bench__thread_ncmp++ == 0)
+		pthread_setspecific(bench__ncmp_key, &bench__thread_ncmp);
+}
+
+static void ncmp_reset()
+{
+	pthread_once(&bench__ncmp_once, ncmp_init);
+	bench__ncmp = 0;
+	bench__thread_ncmp = 0;
+}
+
+/// Comparisons since ncmp_reset(), after the threads that made them are joined.
+static uint64_t ncmp_total()
+{
+	return __atomic_load_n(&bench__ncmp, __ATOMIC_RELAXED) + bench__thread_ncmp;
+}
+
+/// Comparator of Onegin without keys: letter by letter.
+static int baseline_cmp(void const* vs1, void const* vs2)
+{
+	strv_t const* s1 = (strv_t const*)vs1;
+	strv_t const* s2 = (strv_t const*)vs2;
+
+	char const* p1 = s1->pfirst;
+	char const* p2 = s2->pfirst;
+
+	ncmp_count();
+	while(1) {
+		unsigned c1 = 0;
+		unsigned c2 = 0;
+		while(p1 < s1->plast && (c1 = collate_letter(&p1, s1->plast)) == 0) {}
+		while(p2 < s2->plast && (c2 = collate_letter(&p2, s2->plast)) == 0) {}
+
+		if(c1 != c2 || c1 == 0)
+			return (c1 > c2) - (c1 < c2);
+	}
+}
+
+static int key_cmp(void const* vr1, void const* vr2, void* vkeys)
+{
+	ncmp_count();
+	return sortrec_cmp((sortrec_t const*)vr1, (sortrec_t const*)vr2,
+					   (keyarena_t const*)vkeys);
+}
+
+/// FNV-1a, the hash of the output is built line by line.
+static uint64_t checksum(uint64_t hash, char const* const data, size_t const size)
+{
+	for(size_t i = 0; i < size; ++i) {
+		hash = (hash ^ (unsigned char)data[i]) * 0x100000001B3ULL;
+	}
+	return hash;
+}
+#define CHECKSUM_INIT 0xCBF29CE484222325ULL
+
+static uint64_t checksum_line(uint64_t const hash, strv_t const* const line)
+{
+	return checksum(checksum(hash, line->pfirst, (size_t)(line->plast - line->pfirst)),
+					"\n", 1);
+}
+
+/*
+ * In-memory engines: the corpus is mapped and split like Onegin does it, then the
+ * keys are built and sorted. Engines take their time without hashing the output.
+ */
+typedef struct {
+	char* text;
+	size_t size;
+	strv_t* lines;
+	size_t nlines;
+	keyarena_t keys;
+	sortrec_t* recs;
+	size_t nrecs;
+} bench_text_t;
+
+static int text_load(bench_ctx_t const* const ctx, bench_text_t* const text,
+					 int const orders)
+{
+	rewind(ctx->corpus);
+	if((text->text = map_text(ctx->corpus, MT_PRIVATE, &text->size, NULL)) == NULL ||
+	   (text->lines = get_text_lines(text->text, text->size, '\n', &text->nlines)) == NULL)
+		return 0;
+
+	if(orders != 0) {
+		keyorder_t const order = orders == KEYS_REVERSE ? KEYS_REVERSE : KEYS_FORWARD;
+		if(!keyarena_init(&text->keys, text->lines, text->nlines, orders) ||
+		   (text->recs = sortrec_make(&text->keys, keyarena_first(&text->keys, order),
+									  text->nlines)) == NULL)
+			return 0;
+		text->nrecs = text->nlines;
+	}
+	return 1;
+}
+
+static uint64_t text_checksum(bench_text_t const* const text)
+{
+	uint64_t hash = CHECKSUM_INIT;
+	for(size_t i = 0; i < text->nrecs; ++i) {
+		hash = checksum_line(hash, &text->lines[keyarena_line(&text->keys,
+															  text->recs[i].index)]);
+	}
+	return hash;
+}
+
+static void text_free(bench_text_t* const text)
+{
+	free(text->recs);
+	keyarena_free(&text->keys);
+	free(text->lines);
+	unmap_text(text->text, text->size);
+}
+
+static int run_lines(bench_ctx_t const* const ctx, size_t const param,
+					 bench_result_t* const res)
+{
+	(void)param;
+	bench_text_t text = {};
+	double const start = now();
+	res->ok = text_load(ctx, &text, 0);
+	res->time = now() - start;
+	text_free(&text);
+	return res->ok;
+}
+
+static int run_keys(bench_ctx_t const* const ctx, size_t const param,
+					bench_result_t* const res)
+{
+	bench_text_t text = {};
+	double const start = now();
+	res->ok = text_load(ctx, &text, (int)param);
+	res->time = now() - start;
+	text_free(&text);
+	return res->ok;
+}
+
+static int run_qsort(bench_ctx_t const* const ctx, size_t const param,
+					 bench_result_t* const res)
+{
+	(void)param;
+	bench_text_t text = {};
+	double const start = now();
+	if(text_load(ctx, &text, 0)) {
+		ncmp_reset();
+		qsort(text.lines, text.nlines, sizeof(strv_t), baseline_cmp);
+		res->time = now() - start;
+		res->ncmp = ncmp_total();
+
+		// qsort() is not stable, so its order is only checked
+		res->ok = 1;
+		for(size_t i = 1; i < text.nlines && res->ok; ++i) {
+			res->ok = baseline_cmp(&text.lines[i - 1], &text.lines[i]) <= 0;
+		}
+	}
+	text_free(&text);
+	return res->ok;
+}
+
+static int run_qsort_keys(bench_ctx_t const* const ctx, size_t const param,
+						  bench_result_t* const res)
+{
+	(void)param;
+	bench_text_t text = {};
+	double const start = now();
+	if(text_load(ctx, &text, KEYS_FORWARD)) {
+		ncmp_reset();
+		qsort_r(text.recs, text.nrecs, sizeof(sortrec_t), key_cmp, &text.keys);
+		res->time = now() - start;
+		res->ncmp = ncmp_total();
+		res->ok = 1;
+	}
+	res->checksum = text_checksum(&text);
+	text_free(&text);
+	return res->ok;
+}
+
+static int run_psort(bench_ctx_t const* const ctx, size_t const param,
+					 bench_result_t* const res, keyorder_t const order)
+{
+	bench_text_t text = {};
+	double const start = now();
+	if(text_load(ctx, &text, order)) {
+		ncmp_reset();
+		psort(text.recs, text.nrecs, sizeof(sortrec_t), key_cmp, &text.keys, param);
+		res->time = now() - start;
+		res->ncmp = ncmp_total();
+		res->ok = 1;
+	}
+	res->checksum = text_checksum(&text);
+	text_free(&text);
+	return res->ok;
+}
+
+static int run_psort_forward(bench_ctx_t const* const ctx, size_t const param,
+							 bench_result_t* const res)
+{
+	return run_psort(ctx, param, res, KEYS_FORWARD);
+}
+
+static int run_psort_reverse(bench_ctx_t const* const ctx, size_t const param,
+							 bench_result_t* const res)
+{
+	return run_psort(ctx, param == 0 ? ctx->opts->max_threads : param, res, KEYS_REVERSE);
+}
+
+static int run_radix(bench_ctx_t const* const ctx, size_t const param,
+					 bench_result_t* const res)
+{
+	bench_text_t text = {};
+	double const start = now();
+	if(text_load(ctx, &text, param != 0 ? (int)param : KEYS_FORWARD)) {
+		radix_sort(text.recs, text.nrecs, &text.keys);
+		res->time = now() - start;
+		res->ok = 1;
+	}
+	res->checksum = text_checksum(&text);
+	text_free(&text);
+	return res->ok;
+}
+
+/// Runs the query of sortrec_query(): unique lines by psort() (param 0) or
+/// radix_sort(), or the top lines.
+static int run_query(bench_ctx_t const* const ctx, size_t const param,
+					 bench_result_t* const res, sortquery_t const* const query)
+{
+	bench_text_t text = {};
+	double const start = now();
+	if(text_load(ctx, &text, KEYS_FORWARD)) {
+		res->ok = sortrec_query(text.recs, &text.nrecs, &text.keys, KEYS_FORWARD, query,
+								(int)param, ctx->opts->max_threads, NULL);
+		res->time = now() - start;
+	}
+	res->checksum = text_checksum(&text);
+	text_free(&text);
+	return res->ok;
+}
+
+static int run_unique(bench_ctx_t const* const ctx, size_t const param,
+					  bench_result_t* const res)
+{
+	sortquery_t const query = { .unique = UNIQUE_FIRST };
+	return run_query(ctx, param, res, &query);
+}
+
+static int run_top(bench_ctx_t const* const ctx, size_t const param,
+				   bench_result_t* const res)
+{
+	sortquery_t const query = { .top = BENCH_TOP_LINES };
+	return run_query(ctx, param, res, &query);
+}
+
+/// extsort() from the corpus to a temporary file. The file is hashed after the time
+/// is taken.
+static int run_extsort(bench_ctx_t const* const ctx, size_t const param,
+					   bench_result_t* const res)
+{
+	FILE* const output = tmpfile();
+	if(output == NULL)
+		return 0;
+
+	rewind(ctx->corpus);
+	extsort_params_t const params = {
+		ctx->opts->mem, 0, ctx->opts->max_threads, { .unique = (unique_t)param },
+		output, NULL, NULL
+	};
+	double const start = now();
+	res->ok = extsort(fileno(ctx->corpus), &params) == EXTSORT_ERR_OK;
+	res->time = now() - start;
+
+	rewind(output);
+	uint64_t hash = CHECKSUM_INIT;
+	char buffer[1 << 16];
+	size_t nread = 0;
+	while((nread = fread(buffer, sizeof(char), sizeof(buffer), output)) > 0) {
+		hash = checksum(hash, buffer, nread);
+	}
+	res->checksum = hash;
+	res->ok = res->ok && !ferror(output);
+
+	fclose(output);
+	return res->ok;
+}
+
+static bench_engine_t const ENGINES[] = {
+	{ "lines",   "lines",          run_lines,         0, BENCH_NONE },
+	{ "keys",    "keys",           run_keys,          KEYS_FORWARD, BENCH_NONE },
+	{ "keys",    "keys both",      run_keys,          KEYS_FORWARD | KEYS_REVERSE,
+																	BENCH_NONE },
+	{ "qsort",   "qsort",          run_qsort,         0, BENCH_NONE },
+	{ "qsort",   "qsort keys",     run_qsort_keys,    0, BENCH_SORT },
+	{ "psort",   "psort",          run_psort_forward, 0, BENCH_SORT },
+	{ "radix",   "radix",          run_radix,         0, BENCH_SORT },
+	{ "reverse", "reverse psort",  run_psort_reverse, 0, BENCH_REVERSE },
+	{ "reverse", "reverse radix",  run_radix,         KEYS_REVERSE, BENCH_REVERSE },
+	{ "unique",  "unique psort",   run_unique,        0, BENCH_UNIQUE },
+	{ "unique",  "unique radix",   run_unique,        1, BENCH_UNIQUE },
+	{ "top",     "top",            run_top,           0, BENCH_TOP },
+	{ "extsort", "extsort",        run_extsort,       UNIQUE_NONE, BENCH_SORT },
+	{ "extsort", "extsort unique", run_extsort,       UNIQUE_FIRST, BENCH_UNIQUE },
+};
+
+/// Checks whether the group is in the comma separated list.
+static int selected(char const* const list, char const* const group)
+{
+	if(list == NULL)
+		return 1;
+
+	size_t const len = strlen(group);
+	for(char const* item = list; item != NULL; item = strchr(item, ',')) {
+		if(*item == ',')
+			++item;
+		if(strncmp(item, group, len) == 0 && (item[len] == ',' || item[len] == '\0'))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+ * Runs the engine in a child process. The child writes the result to a pipe, its
+ * peak RSS comes from wait4().
+ */
+static int run_engine(bench_ctx_t const* const ctx, bench_engine_t const* const engine,
+					  size_t const param, bench_result_t* const res, long* const maxrss)
+{
+	int fds[2];
+	if(pipe(fds) != 0)
+		return 0;
+
+	fflush(stdout);
+	pid_t const pid = fork();
+	if(pid < 0) {
+		close(fds[0]);
+		close(fds[1]);
+		return 0;
+	}
+
+	if(pid == 0) {
+		close(fds[0]);
+
+		bench_result_t child = { .ncmp = UINT64_MAX };
+		engine->run(ctx, param, &child);
+
+		int const ok = write(fds[1], &child, sizeof(child)) == sizeof(child);
+		_exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	close(fds[1]);
+	int const nread = read(fds[0], res, sizeof(*res)) == sizeof(*res);
+	close(fds[0]);
+
+	int status = 0;
+	struct rusage usage = {};
+	if(wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) ||
+	   WEXITSTATUS(status) != EXIT_SUCCESS || !nread)
+		return 0;
+
+	*maxrss = usage.ru_maxrss;
+	return 1;
+}
+
+static void report(char const* const name, bench_result_t const* const res,
+				   size_t const nlines, long const maxrss)
+{
+	char ncmp[32] = "-";
+	if(res->ncmp != UINT64_MAX)
+		snprintf(ncmp, sizeof(ncmp), "%llu", (unsigned long long)res->ncmp);
+
+	printf("%-16s %9.3f %10.2f %9.1f %15s\n", name, res->time,
+		   (double)nlines / res->time * 1e-6, (double)maxrss / 1024, ncmp);
+}
+
+/// Runs the selected engines on the corpus. Returns 0 if any of them failed or their
+/// outputs differ.
+static int bench(FILE* const corpus, bench_options_t const* const opts)
+{
+	size_t size = 0;
+	char* const text = map_text(corpus, MT_READONLY, &size, NULL);
+	if(text == NULL) {
+		fprintf(stderr, "failed to read the corpus\n");
+		return 0;
+	}
+	bench_ctx_t const ctx = { corpus, count_lines(text, size, '\n'), opts };
+	unmap_text(text, size);
+
+	printf("%zu lines\n", ctx.nlines);
+	printf("%-16s %9s %10s %9s %15s\n",
+		   "engine", "time, s", "Mlines/s", "RSS, MB", "comparisons");
+
+	int ok = 1;
+	int have[BENCH_NMODES] = {};
+	uint64_t checksums[BENCH_NMODES] = {};
+
+	for(size_t i = 0; i < sizeof(ENGINES) / sizeof(ENGINES[0]); ++i) {
+		bench_engine_t const* const engine = &ENGINES[i];
+		if(!selected(opts->engines, engine->group))
+			continue;
+
+		// psort runs on 1, 2, 4.. threads
+		int const threads = engine->run == run_psort_forward;
+		size_t param = threads ? 1 : engine->param;
+		do {
+			char name[32];
+			if(threads) {
+				snprintf(name, sizeof(name), "%s %zu", engine->name, param);
+			} else {
+				snprintf(name, sizeof(name), "%s", engine->name);
+			}
+
+			bench_result_t res = {};
+			long maxrss = 0;
+			if(!run_engine(&ctx, engine, param, &res, &maxrss) || !res.ok) {
+				fprintf(stderr, "%s: failed\n", name);
+				ok = 0;
+				break;
+			}
+			report(name, &res, ctx.nlines, maxrss);
+
+			if(engine->mode != BENCH_NONE) {
+				if(!have[engine->mode]) {
+					have[engine->mode] = 1;
+					checksums[engine->mode] = res.checksum;
+				} else if(checksums[engine->mode] != res.checksum) {
+					fprintf(stderr, "%s: output differs from the first engine's\n", name);
+					ok = 0;
+				}
+			}
+			param *= 2;
+		} while(threads && param <= opts->max_threads);
+	}
+	return ok;
+}
+
+static int parse_options(int argc, char* argv[], bench_options_t* const opts)
+{
+	static struct option const LONGOPTS[] = {
+		{ "lines",    required_argument, NULL, 'l' },
+		{ "dup",      required_argument, NULL, 'd' },
+		{ "punct",    required_argument, NULL, 'p' },
+		{ "alphabet", required_argument, NULL, 'a' },
+		{ "seed",     required_argument, NULL, 's' },
+		{ "corpus",   required_argument, NULL, 'c' },
+		{ "input",    required_argument, NULL, 'i' },
+		{ "engines",  required_argument, NULL, 'e' },
+		{ "threads",  required_argument, NULL, 't' },
+		{ "mem",      required_argument, NULL, 'm' },
+		{ "help",     no_argument,       NULL, 'h' },
+		{ NULL, 0, NULL, 0 },
+	};
+
+	int opt = 0;
+	while((opt = getopt_long(argc, argv, "l:d:p:a:s:c:i:e:t:m:h", LONGOPTS, NULL)) != -1) {
+		int n = 0;
+		switch(opt) {
+		case 'l':
+			if((n = parse_name(optarg, CORPUS_LINES_NAMES, CORPUS_NLINES)) < 0)
+				return 0;
+			opts->corpus.lines = (corpus_lines_t)n;
+			break;
+
+		case 'a':
+			if((n = parse_name(optarg, CORPUS_ALPHABET_NAMES, CORPUS_NALPHABETS)) < 0)
+				return 0;
+			opts->corpus.alphabet = (corpus_alphabet_t)n;
+			break;
+
+		case 'd': if(!parse_share(optarg, &opts->corpus.dup)) return 0; break;
+		case 'p': if(!parse_share(optarg, &opts->corpus.punct)) return 0; break;
+		case 's': opts->corpus.seed = strtoull(optarg, NULL, 10); break;
+		case 'c': opts->corpus_file = optarg; break;
+		case 'i': opts->input = optarg; break;
+		case 'e': opts->engines = optarg; break;
+
+		case 't':
+			if((opts->max_threads = (size_t)atol(optarg)) == 0)
+				return 0;
+			break;
+
+		case 'm':
+			if((opts->mem = parse_size(optarg)) == 0)
+				return 0;
+			break;
+
+		case 'h':
+			fputs(USAGE, stdout);
+			exit(EXIT_SUCCESS);
+
+		default:
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int main(int argc, char* argv[])
+{
+	long const ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	bench_options_t opts = {
+		.corpus = { .punct = 1.0 / 6 },
+		.max_threads = ncpus > 1 ? (size_t)ncpus : 1,
+		.mem = 64 << 20,
+	};
+	if(!parse_options(argc, argv, &opts)) {
+		fputs(USAGE, stderr);
+		return EXIT_FAILURE;
+	}
+
+	static char const* const DEFAULT_SIZES[] = { "1M", "16M", "256M" };
+	char const* const* sizes = DEFAULT_SIZES;
+	int nsizes = sizeof(DEFAULT_SIZES) / sizeof(DEFAULT_SIZES[0]);
+	if(optind < argc) {
+		sizes = (char const* const*)argv + optind;
+		nsizes = argc - optind;
+	}
+
+	if(opts.input != NULL) {
+		FILE* const corpus = fopen(opts.input, "r");
+		if(corpus == NULL) {
+			fprintf(stderr, "file \'%s\' not found\n", opts.input);
+			return EXIT_FAILURE;
+		}
+		printf("\n%s: ", opts.input);
+		int const ok = bench(corpus, &opts);
+		fclose(corpus);
+		return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	int status = EXIT_SUCCESS;
+	for(int i = 0; i < nsizes; ++i) {
+		opts.corpus.size = parse_size(sizes[i]);
+		if(opts.corpus.size == 0) {
+			fprintf(stderr, "invalid size \'%s\'\n", sizes[i]);
+			return EXIT_FAILURE;
+		}
+
+		FILE* const corpus = opts.corpus_file != NULL ? fopen(opts.corpus_file, "w+") :
+														tmpfile();
+		if(corpus == NULL || !corpus_write(corpus, &opts.corpus)) {
+			fprintf(stderr, "failed to write the corpus\n");
+			return EXIT_FAILURE;
+		}
+		if(opts.corpus_file != NULL) {
+			fclose(corpus);
+			return EXIT_SUCCESS;
+		}
+
+		printf("\n%s: %s lines, %s, %.0f%% repeated, %.0f%% punctuation, ", sizes[i],
+			   CORPUS_LINES_NAMES[opts.corpus.lines],
+			   CORPUS_ALPHABET_NAMES[opts.corpus.alphabet],
+			   opts.corpus.dup * 100, opts.corpus.punct * 100);
+		if(!bench(corpus, &opts))
+			status = EXIT_FAILURE;
+		fclose(corpus);
+	}
+	return status;
+}
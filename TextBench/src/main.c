@@ -0,0 +1,351 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <ttrack/text.h>
+#include <ttrack/linereader.h>
+
+/*
+ * Measures line splitting speed on generated text: the byte by byte count + split
+ * (the implementation text.c had before SIMD) against get_text_lines() with every
+ * instruction set supported by the CPU and with get_text_lines_mt() on 2..N threads,
+ * then linereader over a file of the text, then the stdio loop write_lines() had
+ * before against the current write_lines(). Before measuring, linereader is checked
+ * on small inputs with tiny buffers from files and pipes.
+ */
+
+static double now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static char* generate(size_t const size)
+{
+	char* const text = (char*)malloc(size + 1);
+	if(text == NULL) {
+		return NULL;
+	}
+
+	srand(42);
+	for(size_t i = 0; i < size; ++i) {
+		// lines of 40 symbols on average
+		text[i] = rand() % 40 == 0 ? '\n' : (char)('a' + rand() % 26);
+	}
+	text[size] = '\0';
+	return text;
+}
+
+static strv_t* baseline_lines(char const* const text, size_t const size, 
+							  size_t* const pnlines)
+{
+	size_t nlines = 1;
+	for(char const* ch = text; ch < text + size; ++ch) {
+		if(*ch == '\n')
+			++nlines;
+	}
+
+	strv_t* const lines = (strv_t*)calloc(nlines, sizeof(strv_t));
+	if(lines == NULL) {
+		return NULL;
+	}
+
+	strv_t* curline = lines;
+	char const* rover = text;
+	for(char const* ch = text; ch < text + size; ++ch) {
+		if(*ch == '\n') {
+			*curline++ = strv_init(rover, ch);
+			rover = ch + 1;
+		}
+	}
+	*curline = strv_init(rover, text + size);
+
+	*pnlines = nlines;
+	return lines;
+}
+
+static void report(char const* const name, double const time, size_t const size,
+				   size_t const nlines);
+
+/// Returns a descriptor of the input: a temporary file or a pipe written by a child.
+static int reader_input(char const* const input, size_t const size, int const use_pipe)
+{
+	if(!use_pipe) {
+		FILE* const file = tmpfile();
+		if(file == NULL)
+			return -1;
+
+		int const fd = dup(fileno(file));
+		int const ok = fwrite(input, sizeof(char), size, file) == size && fflush(file) == 0;
+		fclose(file);
+		if(!ok || fd < 0 || lseek(fd, 0, SEEK_SET) != 0) {
+			if(fd >= 0)
+				close(fd);
+			return -1;
+		}
+		return fd;
+	}
+
+	int fds[2] = {};
+	if(pipe(fds) != 0)
+		return -1;
+
+	pid_t const pid = fork();
+	if(pid < 0) {
+		close(fds[0]);
+		close(fds[1]);
+		return -1;
+	}
+	if(pid == 0) {
+		// small writes, so the reader gets partial reads
+		close(fds[0]);
+		for(size_t pos = 0; pos < size; pos += 3) {
+			size_t const n = size - pos < 3 ? size - pos : 3;
+			if(write(fds[1], input + pos, n) != (ssize_t)n)
+				_exit(EXIT_FAILURE);
+		}
+		_exit(EXIT_SUCCESS);
+	}
+
+	close(fds[1]);
+	return fds[0];
+}
+
+/*
+ * Reads the input with the capacity and compares the result with its lines. Lines
+ * up to the capacity must be returned whole, longer ones in pieces of up to twice
+ * the capacity.
+ */
+static int check_reader(char const* const input, size_t const capacity, int const use_pipe)
+{
+	size_t const size = strlen(input);
+	int const fd = reader_input(input, size, use_pipe);
+	linereader_t reader = {};
+	if(fd < 0 || linereader_init(&reader, fd, capacity, '\n', 1) != LINEREADER_ERR_OK) {
+		fprintf(stderr, "linereader: failed to open the input\n");
+		return 0;
+	}
+
+	int ok = 1;
+	char const* const end = input + size;
+	char const* expected = input;
+	strv_t line = {};
+	while(ok && expected < end) {
+		char const* sep = (char const*)memchr(expected, '\n', (size_t)(end - expected));
+		if(sep == NULL)
+			sep = end;
+
+		size_t const len = (size_t)(sep - expected);
+		size_t got = 0;
+		do {
+			ok = linereader_next(&reader, &line) == LINEREADER_ERR_OK &&
+				 got + strv_len(&line) <= len && (strv_len(&line) != 0 || len == 0) &&
+				 (strv_len(&line) == len || (len > capacity && 
+											 strv_len(&line) <= 2 * capacity)) &&
+				 memcmp(strv_begin(&line), expected + got, strv_len(&line)) == 0;
+			got += strv_len(&line);
+		} while(ok && got < len);
+
+		expected = sep + 1;
+	}
+	ok = ok && linereader_next(&reader, &line) == LINEREADER_ERR_EOF;
+	linereader_free(&reader);
+
+	if(use_pipe) {
+		int status = 0;
+		ok = wait(&status) > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0 && ok;
+	}
+	if(!ok) {
+		fprintf(stderr, "linereader: wrong lines of \"%s\" with capacity %zu from %s\n",
+				input, capacity, use_pipe ? "a pipe" : "a file");
+	}
+	return ok;
+}
+
+static int check_linereader()
+{
+	static char const* const INPUTS[] = {
+		"",
+		"\n",
+		"a",
+		"a\n\n",
+		"no separator at the end",
+		"ab\ncd\nefg\nhijk\nlmnop\nqr\n",
+		"short\na line longer than every buffer\nx\n\n\ny",
+		"0123456789abcdefghijklmnopqrstuvwxyz",
+	};
+
+	int ok = 1;
+	for(size_t i = 0; i < sizeof(INPUTS) / sizeof(INPUTS[0]); ++i) {
+		for(size_t capacity = 1; capacity <= 16; ++capacity) {
+			ok &= check_reader(INPUTS[i], capacity, 0);
+			ok &= check_reader(INPUTS[i], capacity, 1);
+		}
+	}
+	return ok;
+}
+
+/// Reads the text with linereader, the lines and their total length are checked.
+static int bench_linereader(char const* const text, size_t const size, 
+							size_t const nbase)
+{
+	int const fd = reader_input(text, size, 0);
+	linereader_t reader = {};
+	if(fd < 0 || linereader_init(&reader, fd, 0, '\n', 1) != LINEREADER_ERR_OK) {
+		fprintf(stderr, "linereader: failed to write the text to a file\n");
+		return 0;
+	}
+
+	size_t nlines = 0;
+	size_t nbytes = 0;
+	strv_t line = {};
+	linereader_err_t err = LINEREADER_ERR_OK;
+
+	double const start = now();
+	while((err = linereader_next(&reader, &line)) == LINEREADER_ERR_OK) {
+		++nlines;
+		nbytes += strv_len(&line);
+	}
+	report("linereader", now() - start, size, nlines);
+	linereader_free(&reader);
+
+	// the empty line after the last separator is not returned
+	size_t const nexpected = size != 0 && text[size - 1] == '\n' ? nbase - 1 : nbase;
+	if(err != LINEREADER_ERR_EOF || nlines != nexpected || nbytes != size - (nbase - 1)) {
+		fprintf(stderr, "linereader: lines differ from the baseline\n");
+		return 0;
+	}
+	return 1;
+}
+
+static int baseline_write(FILE* const file, strv_t const* const lines, size_t const nlines)
+{
+	for(size_t i = 0; i < nlines; ++i) {
+		size_t size = strv_len(&lines[i]);
+		if(fwrite(strv_begin(&lines[i]), sizeof(char), size, file) != size)
+			return 0;
+
+		if(fputc((int)'\n', file) == EOF)
+			return 0;
+	}
+	return 1;
+}
+
+static int bench_write(char const* const name, char const* const filename, 
+					   int (*write_fn)(FILE* const, strv_t const* const, size_t const),
+					   strv_t const* const lines, size_t const nlines, size_t const size)
+{
+	FILE* const file = fopen(filename, "w");
+	if(file == NULL) {
+		fprintf(stderr, "failed to open \'%s\'\n", filename);
+		return 0;
+	}
+
+	double const start = now();
+	int const ok = write_fn(file, lines, nlines);
+	fclose(file);
+	report(name, now() - start, size, nlines);
+
+	if(!ok) {
+		fprintf(stderr, "%s: write failed\n", name);
+	}
+	return ok;
+}
+
+static void report(char const* const name, double const time, size_t const size,
+				   size_t const nlines)
+{
+	printf("%-10s %10.3f %10.2f %12zu\n", name, time, (double)size / time * 1e-9, nlines);
+}
+
+int main(int argc, char* argv[])
+{
+	size_t const mbytes = argc > 1 ? (size_t)atol(argv[1]) : 256;
+	size_t const max_threads = argc > 2 ? (size_t)atol(argv[2]) : 8;
+	char const* const output = argc > 3 ? argv[3] : "/dev/null";
+	if(mbytes == 0) {
+		fprintf(stderr, "usage: textbench [text size, MB] [max threads] [output file]\n");
+		return EXIT_FAILURE;
+	}
+
+	size_t const size = mbytes << 20;
+	char* const text = generate(size);
+	if(text == NULL) {
+		fprintf(stderr, "failed to allocate %zu MB\n", mbytes);
+		return EXIT_FAILURE;
+	}
+
+	if(!check_linereader()) {
+		free(text);
+		return EXIT_FAILURE;
+	}
+
+	printf("%-10s %10s %10s %12s\n", "method", "time, s", "GB/s", "lines");
+
+	size_t nbase = 0;
+	double start = now();
+	strv_t* const base = baseline_lines(text, size, &nbase);
+	report("baseline", now() - start, size, nbase);
+	if(base == NULL) {
+		free(text);
+		return EXIT_FAILURE;
+	}
+
+	static char const* const SIMDSTR[] = { "auto", "scalar", "sse2", "avx2" };
+	int status = EXIT_SUCCESS;
+
+	for(text_simd_t simd = TEXT_SIMD_SCALAR; simd <= TEXT_SIMD_AVX2; ++simd) {
+		if(text_set_simd(simd) != simd) {
+			printf("%-10s not supported\n", SIMDSTR[simd]);
+			continue;
+		}
+
+		size_t nlines = 0;
+		start = now();
+		strv_t* const lines = get_text_lines(text, size, '\n', &nlines);
+		report(SIMDSTR[simd], now() - start, size, nlines);
+
+		if(lines == NULL || nlines != nbase || 
+		   memcmp(lines, base, nlines * sizeof(strv_t)) != 0) {
+			fprintf(stderr, "%s: lines differ from the baseline\n", SIMDSTR[simd]);
+			status = EXIT_FAILURE;
+		}
+		free(lines);
+	}
+
+	text_set_simd(TEXT_SIMD_AUTO);
+	for(size_t nthreads = 2; nthreads <= max_threads; nthreads *= 2) {
+		char name[32];
+		snprintf(name, sizeof(name), "mt %zu", nthreads);
+
+		size_t nlines = 0;
+		start = now();
+		strv_t* const lines = get_text_lines_mt(text, size, '\n', &nlines, nthreads);
+		report(name, now() - start, size, nlines);
+
+		if(lines == NULL || nlines != nbase || 
+		   memcmp(lines, base, nlines * sizeof(strv_t)) != 0) {
+			fprintf(stderr, "%s: lines differ from the baseline\n", name);
+			status = EXIT_FAILURE;
+		}
+		free(lines);
+	}
+
+	if(!bench_linereader(text, size, nbase)) {
+		status = EXIT_FAILURE;
+	}
+
+	// both write the same bytes: size + 1 with the last '\n'
+	if(!bench_write("write old", output, baseline_write, base, nbase, size) ||
+	   !bench_write("write", output, write_lines, base, nbase, size)) {
+		status = EXIT_FAILURE;
+	}
+
+	free(base);
+	free(text);
+	return status;
+}
@@ -0,0 +1,88 @@
+#ifndef TTRACK_LINEREADER_H
+#define TTRACK_LINEREADER_H
+
+#ifdef __GNUC__
+#	pragma GCC diagnostic ignored "-Wignored-qualifiers"
+#endif /* __GNUC__ */
+
+#include <stddef.h>
+#include "strv.h"
+
+/// Default size of one half of the linereader buffer.
+#ifndef LINEREADER_CAPACITY
+#	define LINEREADER_CAPACITY (1 << 20)
+#endif
+
+/// Error codes of the linereader functions.
+typedef enum {
+	LINEREADER_ERR_OK = 0, ///< Terminated successfully.
+	LINEREADER_ERR_EOF,	   ///< No more lines.
+	LINEREADER_ERR_MEMORY, ///< Out of memory (malloc returned NULL).
+	LINEREADER_ERR_IO,	   ///< open() or read() failed. See errno.
+	LINEREADER_ERR_ARG,	   ///< Invalid argument.
+
+	LINEREADER_NERRORS
+} linereader_err_t;
+
+/// Associates error codes of the linereader functions with error strings.
+char const* const linereader_errstr(linereader_err_t const err);
+
+/**
+ * \brief Reads a file line by line in constant memory.
+ *
+ * The buffer consists of two halves of the same size. Data is always read into
+ * the second half; the unfinished line at its end is moved to the end of the
+ * first half before the next read. So lines up to capacity bytes are always
+ * returned whole, longer lines may be returned in pieces of up to 2 * capacity
+ * bytes.
+ */
+typedef struct {
+	int fd;
+	int close_flag;
+	char sep;
+
+	char* buf;			///< 2 * capacity bytes
+	size_t capacity;	///< size of one half of the buffer
+	char const* pos;	///< beginning of the next line
+	char const* end;	///< end of the data in the buffer
+	int eof;			///< read() returned 0
+	int piece;			///< the last line returned is a piece of a longer line
+
+	linereader_err_t err;
+} linereader_t;
+
+/**
+ * \brief Initializes the reader over an open file descriptor.
+ *
+ * \param[in] reader reader to be initialized. Must be nonnull.
+ * \param[in] fd file descriptor opened for reading. Pipes are allowed.
+ * \param[in] capacity size of one half of the buffer, 0 for LINEREADER_CAPACITY.
+ * \param[in] sep line separator.
+ * \param[in] close_flag close fd in linereader_free().
+ */
+linereader_err_t const linereader_init(linereader_t* const reader, int const fd, 
+									   size_t const capacity, char const sep, 
+									   int const close_flag);
+
+/**
+ * \brief Opens the file and initializes the reader over it. See linereader_init().
+ */
+linereader_err_t const linereader_open(linereader_t* const reader, char const* const fname,
+									   size_t const capacity, char const sep);
+
+/// Releases the buffer and closes the file if close_flag was set.
+void linereader_free(linereader_t* const reader);
+
+/**
+ * \brief Returns the next line without the separator.
+ *
+ * Unlike get_text_lines(), the empty line after the last separator is not returned.
+ *
+ * \param[in] reader the reader. Must be nonnull.
+ * \param[out] line the line. Valid until the next call. Must be nonnull.
+ * \return LINEREADER_ERR_OK, LINEREADER_ERR_EOF if there are no more lines or 
+ * 		an error code.
+ */
+linereader_err_t const linereader_next(linereader_t* const reader, strv_t* const line);
+
+#endif /* TTRACK_LINEREADER_H */
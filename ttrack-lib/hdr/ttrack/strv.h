@@ -1,6 +1,9 @@
 #ifndef TTRACK_STRV_H
 #define TTRACK_STRV_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 typedef enum {
 	STRV_ERR_OK = 0,
 	STRV_ERR_NULL,
@@ -44,6 +47,30 @@ strv_t const strv_ntok(strv_t* strv, char const* delimers);
 size_t const strv_tok(strv_t* strv, char const* delimers, strv_t* tokens,
 					  size_t max_count);
 
+/*
+ * Character classes. A class is built once and then searched for by 16 bytes
+ * at a time (SSSE3 nibble lookup) where the CPU supports it.
+ */
+typedef struct {
+	uint64_t bits[4];			// bit c is set if c belongs to the class
+	unsigned char rows[2][16];	// bit (c >> 4) & 7 of rows[c >> 7][c & 15]
+} strv_cset_t;
+
+void strv_cset_init(strv_cset_t* cset, char const* chars);
+int const strv_cset_has(strv_cset_t const* cset, char c);
+
+// returns a pointer to the first matching character or NULL
+char const* strv_find(strv_t const* strv, char c);
+char const* strv_find_any(strv_t const* strv, strv_cset_t const* cset);
+char const* strv_find_not(strv_t const* strv, strv_cset_t const* cset);
+
+size_t const strv_count(strv_t const* strv, char c);
+
+// strv_ntok() and strv_tok() with a prebuilt class of delimiters
+strv_t const strv_ntokc(strv_t* strv, strv_cset_t const* delimers);
+size_t const strv_tokc(strv_t* strv, strv_cset_t const* delimers, strv_t* tokens,
+					   size_t max_count);
+
 strv_err_t const strv_check(strv_t const* strv);
 int const strv_ok(strv_t const* strv);
 
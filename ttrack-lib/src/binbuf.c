@@ -10,6 +10,7 @@ typedef struct {
 	size_t size;
 	size_t capacity;
 	unsigned char* data;
+	int mapped; // data is returned by map_text()
 } binbuf_t;
 
 static binbuf_t binbuf;
@@ -64,6 +65,7 @@ binbuf_err_t const binbuf_init(size_t capacity)
 
 	binbuf.size = 0;
 	binbuf.capacity = capacity;
+	binbuf.mapped = 0;
 	binbuf.err = BINBUF_ERR_OK;
 	RETURN(BINBUF_ERR_OK);
 }
@@ -73,7 +75,7 @@ binbuf_err_t const binbuf_initf(FILE* stream)
 	stream_assert(stream);
 
 	RT_err_t errc;
-	binbuf.data = (unsigned char*)read_text(stream, &binbuf.capacity, &errc);
+	binbuf.data = (unsigned char*)map_text(stream, MT_PRIVATE, &binbuf.capacity, &errc);
 	if(errc == RT_IO) {
 		RETURN(binbuf__set_error(BINBUF_ERR_STDIO));
 	}
@@ -82,6 +84,7 @@ binbuf_err_t const binbuf_initf(FILE* stream)
 	}
 
 	binbuf.size = binbuf.capacity;
+	binbuf.mapped = 1;
 	RETURN(BINBUF_ERR_OK);
 }
 
@@ -111,7 +114,12 @@ $$
 void binbuf_free() 
 {$_
 	binbuf_assert();
-	free(binbuf.data);
+	if(binbuf.mapped) {
+		unmap_text((char*)binbuf.data, binbuf.capacity);
+	}
+	else {
+		free(binbuf.data);
+	}
 $$
 }
 
@@ -163,9 +171,23 @@ static int const binbuf_resize(size_t new_capacity)
 {$_
 	ASSERT(new_capacity != 0);
 	
-	unsigned char* new_data = (unsigned char*)realloc(binbuf.data, new_capacity);
-	if(new_data == NULL) {
-		RETURN(0);
+	unsigned char* new_data = NULL;
+	if(binbuf.mapped) {
+		// mapped data can't be reallocated, it is moved to the heap
+		new_data = (unsigned char*)malloc(new_capacity);
+		if(new_data == NULL) {
+			RETURN(0);
+		}
+		memcpy(new_data, binbuf.data, binbuf.capacity < new_capacity ? binbuf.capacity
+																	  : new_capacity);
+		unmap_text((char*)binbuf.data, binbuf.capacity);
+		binbuf.mapped = 0;
+	}
+	else {
+		new_data = (unsigned char*)realloc(binbuf.data, new_capacity);
+		if(new_data == NULL) {
+			RETURN(0);
+		}
 	}
 
 	binbuf.data = new_data;
@@ -1,10 +1,23 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <assert.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <time.h>
 #include "dbg.h"
 
+#if defined __x86_64__ || defined __i386__
+#	include <x86intrin.h>
+#endif
+
 void dbg__message(char const* const file, int line, FILE* const stream, 
 		char const* const head_format, char const* const body_format, ...) 
 {$_
@@ -28,11 +41,16 @@ $$
 }
 
 
-typedef struct frame_s {
+typedef struct {
 	char const* func;
 	char const* file;
 	size_t line;
-	struct frame_s* next;
+
+	// used only while stacktrace_timing_start() is active, generation is the
+	// timing generation the frame is measured in or 0
+	uint64_t start;
+	uint64_t children;
+	unsigned generation;
 } frame_t;
 
 
@@ -125,9 +143,8 @@ void dump_hex(unsigned char const* data, size_t size) {
 	DUMP_POPTFL
 }
 
-static void frame__init(frame_t* const frame, frame_t* const nextframe,
-			     char const* const funcname, char const* const filename, 
-			     size_t nline)
+static void frame__init(frame_t* const frame, char const* const funcname, 
+						char const* const filename, size_t nline)
 {
 	ASSERT(frame != NULL);
 	ASSERT(funcname != NULL);
@@ -136,30 +153,147 @@ static void frame__init(frame_t* const frame, frame_t* const nextframe,
 	frame->func = funcname;
 	frame->file = filename;
 	frame->line = nline;
-	frame->next = nextframe;
+	frame->start = 0;
+	frame->children = 0;
+	frame->generation = 0;
 
 }
 
-static void frame__dump_body(frame_t* frame) 
+static void frame__dump_body(frame_t const* frame) 
 {
 	dump("[%p] {\n", frame);
 	if(frame != NULL) {
 		dump("\tfunc = \"%s\"\n", frame->func);
 		dump("\tfile = \"%s\"\n", frame->file);
 		dump("\tline = %zu\n", frame->line);
-		dump("\tnext = %p\n", frame->next);
 	}
 	dump("}\n");
 
 }
 
 typedef struct {
-	frame_t* last;
-	size_t depth;
-	size_t ninvframes;
+	char const* func;
+	uint64_t ncalls;
+	uint64_t inclusive;
+	uint64_t exclusive;
+	size_t nactive;
+} timing_entry_t;
+
+typedef struct {
+	char const* func;
+	uint64_t ticks;
+} trace_event_t;
+
+/*
+ * Frames are stored in the preallocated array, so push and pop never touch
+ * the heap. Calls deeper than STACKTRACE_MAXDEPTH are only counted: depth keeps
+ * growing, but nothing is stored until the stack unwinds back into the array.
+ *
+ * Every thread takes its own stacktrace_t from the registry on the first push
+ * and gives it back on exit. Only the owner thread writes its frames, other
+ * threads (crash handlers, stacktrace_print_all) just read them. The timing table
+ * and the trace ring are also merged and flushed by stacktrace_timing_stop() and
+ * stacktrace_trace_stop() from other threads, so they are guarded by spin locks.
+ */
+typedef struct {
+	frame_t frames[STACKTRACE_MAXDEPTH];
+	_Atomic size_t depth;
+	size_t noverflows;
+	long tid;
+	atomic_int busy;
+
+	// per-function statistics, allocated on the first push with timing enabled;
+	// the owner thread and stacktrace_timing_stop() change them under timings_lock
+	timing_entry_t* timings;
+	size_t ntimings_lost;
+	atomic_flag timings_lock;
+
+	// ring of begin (func != NULL) and end (func == NULL) events, allocated
+	// on the first push with tracing enabled; nevents never wraps; the owner
+	// thread and stacktrace_trace_stop() change them under events_lock
+	trace_event_t* events;
+	size_t nevents;
+	atomic_flag events_lock;
 } stacktrace_t;
 
-static stacktrace_t stacktrace = { NULL, 0, 0 };
+static stacktrace_t stacktrace__registry[STACKTRACE_MAXTHREADS];
+
+// used by threads which didn't get a place in the registry
+static _Thread_local stacktrace_t stacktrace__local;
+static atomic_size_t stacktrace__nunregistered;
+
+static _Thread_local stacktrace_t* stacktrace__self;
+// set when the thread gives its stacktrace_t back on exit, so that $_ and $$ in
+// later destructors of the thread don't take a place in the registry again
+static _Thread_local int stacktrace__released;
+
+static pthread_once_t stacktrace__key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t stacktrace__key;
+
+static void stacktrace__timing_merge(stacktrace_t* const st);
+static void stacktrace__trace_flush(stacktrace_t* const st);
+
+static void stacktrace__release(void* data)
+{
+	stacktrace_t* const st = (stacktrace_t*)data;
+
+	stacktrace__timing_merge(st);
+	stacktrace__trace_flush(st);
+
+	stacktrace__self = NULL;
+	stacktrace__released = 1;
+
+	atomic_store_explicit(&st->depth, 0, memory_order_relaxed);
+	st->noverflows = 0;
+	if(st == &stacktrace__local) {
+		atomic_fetch_sub(&stacktrace__nunregistered, 1);
+	}
+	else {
+		atomic_store_explicit(&st->busy, 0, memory_order_release);
+	}
+}
+
+static void stacktrace__setup_env();
+
+static void stacktrace__setup()
+{
+	pthread_key_create(&stacktrace__key, stacktrace__release);
+	stacktrace__setup_env();
+}
+
+static stacktrace_t* stacktrace__attach()
+{
+	pthread_once(&stacktrace__key_once, stacktrace__setup);
+
+	stacktrace_t* st = &stacktrace__local;
+	for(size_t i = 0; i < STACKTRACE_MAXTHREADS; ++i) {
+		int expected = 0;
+		if(atomic_compare_exchange_strong(&stacktrace__registry[i].busy, &expected, 1)) {
+			st = &stacktrace__registry[i];
+			break;
+		}
+	}
+	if(st == &stacktrace__local) {
+		atomic_fetch_add(&stacktrace__nunregistered, 1);
+	}
+	pthread_setspecific(stacktrace__key, st);
+
+	st->tid = (long)syscall(SYS_gettid);
+	stacktrace__self = st;
+	return st;
+}
+
+static size_t const stacktrace__nframes(size_t depth)
+{
+	return depth < STACKTRACE_MAXDEPTH ? depth : STACKTRACE_MAXDEPTH;
+}
+
+static atomic_int stacktrace__timing;
+static atomic_int stacktrace__tracing;
+
+static void stacktrace__timing_push(stacktrace_t* const st, frame_t* const frame);
+static void stacktrace__timing_pop(stacktrace_t* const st, size_t const depth);
+static void stacktrace__trace_event(stacktrace_t* const st, char const* const func);
 
 void stacktrace__push(char const* const funcname, char const* const filename, 
 					  size_t const nline)
@@ -167,47 +301,76 @@ void stacktrace__push(char const* const funcname, char const* const filename,
 	ASSERT(funcname != NULL);
 	ASSERT(filename != NULL);
 
-	frame_t* frame = (frame_t*)malloc(sizeof(frame_t));
-	if(frame == NULL) {
-		++stacktrace.ninvframes;
+	stacktrace_t* st = stacktrace__self;
+	if(st == NULL) {
+		if(stacktrace__released) {
+			return;
+		}
+		st = stacktrace__attach();
+	}
+
+	size_t const depth = atomic_load_explicit(&st->depth, memory_order_relaxed);
+	if(depth < STACKTRACE_MAXDEPTH) {
+		frame__init(&st->frames[depth], funcname, filename, nline);
+
+		if(atomic_load_explicit(&stacktrace__timing, memory_order_relaxed)) {
+			stacktrace__timing_push(st, &st->frames[depth]);
+		}
 	}
 	else {
-		frame__init(frame, stacktrace.last == NULL ? NULL : stacktrace.last, 
-					funcname, filename, nline);
-		stacktrace.last = frame;
+		++st->noverflows;
+	}
+
+	if(atomic_load_explicit(&stacktrace__tracing, memory_order_relaxed)) {
+		stacktrace__trace_event(st, funcname);
 	}
-	++stacktrace.depth;
+	// release: readers from other threads must see the frame before the depth
+	atomic_store_explicit(&st->depth, depth + 1, memory_order_release);
 
 }
 
 void stacktrace__pop() 
 {
-	ASSERT(stacktrace.depth != 0);
-	if(stacktrace.ninvframes != 0) {
-		--stacktrace.ninvframes;
+	stacktrace_t* const st = stacktrace__self;
+	if(st == NULL && stacktrace__released) {
+		return;
 	}
-	else {
-		frame_t* frame = stacktrace.last;
-		stacktrace.last = frame->next;
-		free(frame);
+	ASSERT(st != NULL);
+
+	size_t const depth = atomic_load_explicit(&st->depth, memory_order_relaxed);
+	ASSERT(depth != 0);
+
+	if(depth <= STACKTRACE_MAXDEPTH && st->frames[depth - 1].generation != 0) {
+		stacktrace__timing_pop(st, depth);
+	}
+	if(atomic_load_explicit(&stacktrace__tracing, memory_order_relaxed)) {
+		stacktrace__trace_event(st, NULL);
 	}
-	--stacktrace.depth;
+	atomic_store_explicit(&st->depth, depth - 1, memory_order_release);
 
 }
 
-void stacktrace_dump_body() {
+static stacktrace_t* stacktrace__current()
+{
+	if(stacktrace__self != NULL) {
+		return stacktrace__self;
+	}
+	// the thread is exiting: its own empty stacktrace_t, not a registry place
+	return stacktrace__released ? &stacktrace__local : stacktrace__attach();
+}
+
+static void stacktrace__dump_body(stacktrace_t* const st)
+{
+	size_t const depth = atomic_load_explicit(&st->depth, memory_order_acquire);
 
-	dump("(global variable at [%p]) {\n", &stacktrace);
-	dump("\tdepth = %zu\n", stacktrace.depth);
-	dump("\tninvframes = %zu\n", stacktrace.ninvframes);
-	dump("\tlast = %p\n", stacktrace.last);
+	dump("(thread %li stacktrace at [%p]) {\n", st->tid, st);
+	dump("\tdepth = %zu\n", depth);
+	dump("\tnoverflows = %zu\n", st->noverflows);
 	dump("\tframes =\n\t{\n");
 
 	DUMP_DEPTH += 2;
-	frame_t* frame = stacktrace.last;
-	while(frame != NULL) {
-		frame__dump_body(frame);
-		frame = frame->next;
+	for(size_t i = stacktrace__nframes(depth); i > 0; --i) {
+		frame__dump_body(&st->frames[i - 1]);
 	}
 	DUMP_DEPTH -= 2;
 
@@ -215,6 +378,10 @@ void stacktrace_dump_body() {
 
 }
 
+void stacktrace_dump_body() {
+	stacktrace__dump_body(stacktrace__current());
+}
+
 void stacktrace__dump(char const* funcname, char const* filename, size_t nline) 
 {
 	dump("stacktrace_t dump from %s (%s %zu)\n", funcname, filename, nline);
@@ -222,21 +389,18 @@ void stacktrace__dump(char const* funcname, char const* filename, size_t nline)
 
 }
 
-#define stacktrace_dump() \
-	stacktrace__dump(__func__, __FILE__, __LINE__)
-
-void stacktrace_print(FILE* const stream)
+static void stacktrace__print(stacktrace_t* const st)
 {
-	(void)stream;
-	dump("stacktrace: \n");
+	size_t const depth = atomic_load_explicit(&st->depth, memory_order_acquire);
+	size_t const nframes = stacktrace__nframes(depth);
 
-	for(size_t i = 0; i < stacktrace.ninvframes; ++i) {
-		dump("\t[INVALID FRAME], called from\n");
+	if(depth > nframes) {
+		dump("\t[%zu INVALID FRAMES], called from\n", depth - nframes);
 	}
 
-	frame_t* frame = stacktrace.last;
-	while(frame != NULL) {
-		if(frame->next != NULL) {
+	for(size_t i = nframes; i > 0; --i) {
+		frame_t const* frame = &st->frames[i - 1];
+		if(i > 1) {
 			dump("\t %s (%s %zu), called from\n", frame->func, frame->file, 
 					frame->line);
 		}
@@ -245,8 +409,772 @@ void stacktrace_print(FILE* const stream)
 					frame->line);
 
 		}
-		frame = frame->next;
 	}
 
 }
 
+void stacktrace_print(FILE* const stream)
+{
+	(void)stream;
+	dump("stacktrace: \n");
+	stacktrace__print(stacktrace__current());
+
+}
+
+void stacktrace_print_all(FILE* const stream)
+{
+	(void)stream;
+
+	for(size_t i = 0; i < STACKTRACE_MAXTHREADS; ++i) {
+		stacktrace_t* const st = &stacktrace__registry[i];
+		if(!atomic_load_explicit(&st->busy, memory_order_acquire)) {
+			continue;
+		}
+
+		dump("stacktrace of thread %li%s: \n", st->tid, 
+			 st == stacktrace__self ? " (current)" : "");
+		stacktrace__print(st);
+	}
+
+	size_t const nunregistered = atomic_load(&stacktrace__nunregistered);
+	if(nunregistered != 0) {
+		dump("%zu running threads are not registered (STACKTRACE_MAXTHREADS = %i)\n",
+			 nunregistered, STACKTRACE_MAXTHREADS);
+	}
+
+}
+
+/*
+ * Sampling profiler. SIGPROF handler copies function names of the interrupted
+ * thread's shadow stack into the pool: [nframes, func0, ..., funcN-1], outermost
+ * frame first. Space in the pool is reserved with a single fetch_add, so the
+ * handler never locks and never allocates. Samples which don't fit are counted.
+ */
+typedef struct {
+	char const** pool;
+	size_t capacity;
+	atomic_size_t size;
+	atomic_size_t nlost;
+	char const* filename;
+	atomic_int running;
+} profile_t;
+
+static profile_t profile;
+
+static void stacktrace__profile_handler(int signo)
+{
+	(void)signo;
+
+	stacktrace_t* const st = stacktrace__self;
+	if(st == NULL || !atomic_load_explicit(&profile.running, memory_order_relaxed)) {
+		return;
+	}
+
+	size_t const nframes = stacktrace__nframes(
+		atomic_load_explicit(&st->depth, memory_order_relaxed));
+	if(nframes == 0) {
+		return;
+	}
+
+	size_t const pos = atomic_fetch_add_explicit(&profile.size, nframes + 1,
+												 memory_order_relaxed);
+	if(pos + nframes + 1 > profile.capacity) {
+		atomic_fetch_add_explicit(&profile.nlost, 1, memory_order_relaxed);
+		return;
+	}
+
+	profile.pool[pos] = (char const*)(uintptr_t)nframes;
+	for(size_t i = 0; i < nframes; ++i) {
+		profile.pool[pos + 1 + i] = st->frames[i].func;
+	}
+}
+
+static char const* const* profile__pool_sorted;
+
+static int profile__sample_cmp(void const* vs1, void const* vs2)
+{
+	char const* const* s1 = profile__pool_sorted + *(size_t const*)vs1;
+	char const* const* s2 = profile__pool_sorted + *(size_t const*)vs2;
+
+	size_t const n1 = (size_t)(uintptr_t)s1[0];
+	size_t const n2 = (size_t)(uintptr_t)s2[0];
+
+	for(size_t i = 1; i <= n1 && i <= n2; ++i) {
+		if(s1[i] != s2[i]) {
+			return strcmp(s1[i], s2[i]) < 0 ? -1 : 1;
+		}
+	}
+	return n1 < n2 ? -1 : n1 > n2;
+}
+
+static int profile__sample_eq(char const* const* s1, char const* const* s2)
+{
+	size_t const n = (size_t)(uintptr_t)s1[0];
+	return n == (size_t)(uintptr_t)s2[0] && 
+		   memcmp(s1 + 1, s2 + 1, n * sizeof(char const*)) == 0;
+}
+
+static int const profile__write_folded(FILE* const stream, size_t const size)
+{
+	size_t nsamples = 0;
+	for(size_t pos = 0; pos < size; pos += (size_t)(uintptr_t)profile.pool[pos] + 1) {
+		++nsamples;
+	}
+
+	size_t* samples = (size_t*)calloc(nsamples, sizeof(size_t));
+	if(samples == NULL && nsamples != 0) {
+		return 0;
+	}
+
+	size_t isample = 0;
+	for(size_t pos = 0; pos < size; pos += (size_t)(uintptr_t)profile.pool[pos] + 1) {
+		samples[isample++] = pos;
+	}
+
+	profile__pool_sorted = profile.pool;
+	qsort(samples, nsamples, sizeof(size_t), profile__sample_cmp);
+
+	for(size_t i = 0; i < nsamples; ) {
+		char const* const* sample = profile.pool + samples[i];
+
+		size_t count = 0;
+		for(; i < nsamples && profile__sample_eq(sample, profile.pool + samples[i]); ++i) {
+			++count;
+		}
+
+		size_t const nframes = (size_t)(uintptr_t)sample[0];
+		for(size_t j = 1; j <= nframes; ++j) {
+			fputs(sample[j], stream);
+			fputc(j == nframes ? ' ' : ';', stream);
+		}
+		fprintf(stream, "%zu\n", count);
+	}
+
+	free(samples);
+	return ferror(stream) == 0;
+}
+
+int const stacktrace_profile_start(char const* const filename, unsigned const frequency)
+{
+	ASSERT(filename != NULL);
+	ASSERT(frequency != 0);
+
+	if(atomic_load(&profile.running)) {
+		return 0;
+	}
+
+	if(profile.pool == NULL) {
+		profile.pool = (char const**)calloc(STACKTRACE_PROFILE_BUFSIZE, sizeof(char const*));
+		if(profile.pool == NULL) {
+			return 0;
+		}
+		profile.capacity = STACKTRACE_PROFILE_BUFSIZE;
+		atexit(stacktrace_profile_stop);
+	}
+	else {
+		memset(profile.pool, 0, profile.capacity * sizeof(char const*));
+	}
+
+	profile.filename = filename;
+	atomic_store(&profile.size, 0);
+	atomic_store(&profile.nlost, 0);
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = stacktrace__profile_handler;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	if(sigaction(SIGPROF, &action, NULL) != 0) {
+		return 0;
+	}
+
+	unsigned const usec = frequency >= 1000000 ? 1 : 1000000 / frequency;
+	struct itimerval timer = { { usec / 1000000, usec % 1000000 }, 
+							   { usec / 1000000, usec % 1000000 } };
+
+	atomic_store(&profile.running, 1);
+	if(setitimer(ITIMER_PROF, &timer, NULL) != 0) {
+		atomic_store(&profile.running, 0);
+		return 0;
+	}
+
+	return 1;
+}
+
+void stacktrace_profile_stop()
+{
+	if(!atomic_exchange(&profile.running, 0)) {
+		return;
+	}
+
+	struct itimerval timer;
+	memset(&timer, 0, sizeof(timer));
+	setitimer(ITIMER_PROF, &timer, NULL);
+	signal(SIGPROF, SIG_IGN);
+
+	// reservations are contiguous and the rest of the pool is zeroed
+	size_t size = 0;
+	while(size < profile.capacity && profile.pool[size] != NULL) {
+		size += (size_t)(uintptr_t)profile.pool[size] + 1;
+	}
+
+	FILE* const stream = fopen(profile.filename, "w");
+	if(stream == NULL || !profile__write_folded(stream, size)) {
+		fprintf(stderr, "stacktrace profiler: failed to write \'%s\'\n", 
+				profile.filename);
+	}
+	if(stream != NULL) {
+		fclose(stream);
+	}
+
+	size_t const nlost = atomic_load(&profile.nlost);
+	if(nlost != 0) {
+		fprintf(stderr, "stacktrace profiler: %zu samples lost, increase "
+				"STACKTRACE_PROFILE_BUFSIZE\n", nlost);
+	}
+}
+
+/*
+ * Exact instrumentation. Every stored frame remembers its entry timestamp and
+ * the inclusive time of its callees, on exit the difference goes to the
+ * thread's own open addressing table keyed by the __func__ pointer, so there
+ * is no sharing between threads. Tables are merged into timing.total when
+ * the thread exits and when the report is written.
+ *
+ * stacktrace_timing_stop() merges and clears tables of running threads, so every
+ * table has a spin lock, which is normally taken only by its owner. The
+ * generation is odd while timing is on and changes on every start and stop:
+ * frames entered in another generation are not counted on exit, as their
+ * entries were already merged and cleared.
+ */
+typedef struct {
+	timing_entry_t* total;
+	size_t ntotal_lost;
+	pthread_mutex_t mutex;
+
+	char const* filename;
+	uint64_t start_ticks;
+	uint64_t start_ns;
+} timing_t;
+
+static timing_t timing = { NULL, 0, PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0 };
+
+static atomic_uint timing__generation;
+
+static void timing__lock(stacktrace_t* const st)
+{
+	while(atomic_flag_test_and_set_explicit(&st->timings_lock, memory_order_acquire)) {
+		sched_yield();
+	}
+}
+
+static void timing__unlock(stacktrace_t* const st)
+{
+	atomic_flag_clear_explicit(&st->timings_lock, memory_order_release);
+}
+
+static uint64_t const timing__ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t const timing__ticks()
+{
+#if defined __x86_64__ || defined __i386__
+	return __rdtsc();
+#else
+	return timing__ns();
+#endif
+}
+
+static timing_entry_t* timing__find(timing_entry_t* const table, 
+									 char const* const func)
+{
+	size_t const mask = STACKTRACE_TIMING_NFUNCS - 1;
+	size_t idx = (size_t)(((uintptr_t)func >> 3) * 0x9E3779B97F4A7C15ull) & mask;
+
+	for(size_t i = 0; i < STACKTRACE_TIMING_NFUNCS; ++i, idx = (idx + 1) & mask) {
+		if(table[idx].func == func) {
+			return &table[idx];
+		}
+		if(table[idx].func == NULL) {
+			table[idx].func = func;
+			return &table[idx];
+		}
+	}
+	return NULL;
+}
+
+static void stacktrace__timing_push(stacktrace_t* const st, frame_t* const frame)
+{
+	if(st->timings == NULL) {
+		timing_entry_t* const timings = 
+			(timing_entry_t*)calloc(STACKTRACE_TIMING_NFUNCS, sizeof(timing_entry_t));
+		if(timings == NULL) {
+			return;
+		}
+		timing__lock(st);
+		st->timings = timings;
+		timing__unlock(st);
+	}
+
+	timing__lock(st);
+
+	unsigned const generation = atomic_load_explicit(&timing__generation, 
+													 memory_order_relaxed);
+	// timing is already stopped
+	if(generation % 2 == 0) {
+		timing__unlock(st);
+		return;
+	}
+
+	timing_entry_t* const entry = timing__find(st->timings, frame->func);
+	if(entry == NULL) {
+		++st->ntimings_lost;
+		timing__unlock(st);
+		return;
+	}
+
+	++entry->nactive;
+	timing__unlock(st);
+
+	frame->generation = generation;
+	frame->start = timing__ticks();
+}
+
+static void stacktrace__timing_pop(stacktrace_t* const st, size_t const depth)
+{
+	frame_t* const frame = &st->frames[depth - 1];
+	uint64_t const inclusive = timing__ticks() - frame->start;
+
+	timing__lock(st);
+
+	if(frame->generation != atomic_load_explicit(&timing__generation, 
+												 memory_order_relaxed)) {
+		timing__unlock(st);
+		return;
+	}
+
+	timing_entry_t* const entry = timing__find(st->timings, frame->func);
+	ASSERT(entry != NULL);
+
+	++entry->ncalls;
+	entry->exclusive += inclusive - frame->children;
+	// recursive calls are already covered by the outermost one
+	if(--entry->nactive == 0) {
+		entry->inclusive += inclusive;
+	}
+
+	timing__unlock(st);
+
+	if(depth > 1) {
+		st->frames[depth - 2].children += inclusive;
+	}
+}
+
+static void timing__merge_table(timing_entry_t const* const table)
+{
+	for(size_t i = 0; i < STACKTRACE_TIMING_NFUNCS; ++i) {
+		if(table[i].func == NULL) {
+			continue;
+		}
+
+		timing_entry_t* const entry = timing__find(timing.total, table[i].func);
+		if(entry == NULL) {
+			++timing.ntotal_lost;
+			continue;
+		}
+		entry->ncalls += table[i].ncalls;
+		entry->inclusive += table[i].inclusive;
+		entry->exclusive += table[i].exclusive;
+	}
+}
+
+static void stacktrace__timing_merge(stacktrace_t* const st)
+{
+	// the table is detached first: stacktrace_timing_stop() takes table locks
+	// while holding timing.mutex
+	timing__lock(st);
+	timing_entry_t* const timings = st->timings;
+	size_t const nlost = st->ntimings_lost;
+	st->timings = NULL;
+	st->ntimings_lost = 0;
+	timing__unlock(st);
+
+	if(timings == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&timing.mutex);
+	if(timing.total != NULL) {
+		timing__merge_table(timings);
+		timing.ntotal_lost += nlost;
+	}
+	pthread_mutex_unlock(&timing.mutex);
+
+	free(timings);
+}
+
+static int timing__entry_cmp(void const* ve1, void const* ve2)
+{
+	timing_entry_t const* e1 = (timing_entry_t const*)ve1;
+	timing_entry_t const* e2 = (timing_entry_t const*)ve2;
+
+	if(e1->exclusive != e2->exclusive) {
+		return e1->exclusive > e2->exclusive ? -1 : 1;
+	}
+	return e1->ncalls > e2->ncalls ? -1 : e1->ncalls < e2->ncalls;
+}
+
+static void timing__write_table(FILE* const stream)
+{
+	uint64_t const nticks = timing__ticks() - timing.start_ticks;
+	uint64_t const nns = timing__ns() - timing.start_ns;
+	double const ms_per_tick = nticks == 0 ? 0.0 : (double)nns / (double)nticks / 1e6;
+
+	size_t nentries = 0;
+	for(size_t i = 0; i < STACKTRACE_TIMING_NFUNCS; ++i) {
+		if(timing.total[i].func != NULL) {
+			timing.total[nentries++] = timing.total[i];
+		}
+	}
+	qsort(timing.total, nentries, sizeof(timing_entry_t), timing__entry_cmp);
+
+	uint64_t exclusive = 0;
+	for(size_t i = 0; i < nentries; ++i) {
+		exclusive += timing.total[i].exclusive;
+	}
+
+	fprintf(stream, "%-40s %12s %14s %14s %8s\n", 
+			"function", "calls", "inclusive, ms", "exclusive, ms", "excl, %");
+	for(size_t i = 0; i < nentries; ++i) {
+		timing_entry_t const* const entry = &timing.total[i];
+		fprintf(stream, "%-40s %12llu %14.3f %14.3f %8.2f\n", entry->func,
+				(unsigned long long)entry->ncalls,
+				(double)entry->inclusive * ms_per_tick,
+				(double)entry->exclusive * ms_per_tick,
+				exclusive == 0 ? 0.0 : 100.0 * (double)entry->exclusive / (double)exclusive);
+	}
+
+	if(timing.ntotal_lost != 0) {
+		fprintf(stream, "%zu records lost, increase STACKTRACE_TIMING_NFUNCS\n",
+				timing.ntotal_lost);
+	}
+}
+
+int const stacktrace_timing_start(char const* const filename)
+{
+	pthread_mutex_lock(&timing.mutex);
+
+	if(atomic_load(&stacktrace__timing)) {
+		pthread_mutex_unlock(&timing.mutex);
+		return 0;
+	}
+
+	if(timing.total == NULL) {
+		timing.total = (timing_entry_t*)calloc(STACKTRACE_TIMING_NFUNCS, 
+											   sizeof(timing_entry_t));
+		if(timing.total == NULL) {
+			pthread_mutex_unlock(&timing.mutex);
+			return 0;
+		}
+		atexit(stacktrace_timing_stop);
+	}
+	else {
+		memset(timing.total, 0, STACKTRACE_TIMING_NFUNCS * sizeof(timing_entry_t));
+	}
+
+	timing.ntotal_lost = 0;
+	timing.filename = filename;
+	timing.start_ticks = timing__ticks();
+	timing.start_ns = timing__ns();
+
+	atomic_fetch_add(&timing__generation, 1);
+	atomic_store(&stacktrace__timing, 1);
+	pthread_mutex_unlock(&timing.mutex);
+	return 1;
+}
+
+void stacktrace_timing_stop()
+{
+	if(!atomic_exchange(&stacktrace__timing, 0)) {
+		return;
+	}
+
+	// calls still on the stacks are not finished and are not reported
+	pthread_mutex_lock(&timing.mutex);
+	atomic_fetch_add(&timing__generation, 1);
+	for(size_t i = 0; i < STACKTRACE_MAXTHREADS; ++i) {
+		stacktrace_t* const st = &stacktrace__registry[i];
+		if(!atomic_load(&st->busy)) {
+			continue;
+		}
+
+		timing__lock(st);
+		if(st->timings != NULL) {
+			timing__merge_table(st->timings);
+			timing.ntotal_lost += st->ntimings_lost;
+			memset(st->timings, 0, STACKTRACE_TIMING_NFUNCS * sizeof(timing_entry_t));
+			st->ntimings_lost = 0;
+		}
+		timing__unlock(st);
+	}
+
+	FILE* const stream = timing.filename == NULL ? stderr : fopen(timing.filename, "w");
+	if(stream == NULL) {
+		fprintf(stderr, "stacktrace timing: failed to open \'%s\'\n", timing.filename);
+	}
+	else {
+		timing__write_table(stream);
+		if(stream != stderr) {
+			fclose(stream);
+		}
+	}
+	pthread_mutex_unlock(&timing.mutex);
+}
+
+/*
+ * Chrome trace-event export. Every thread appends events to its own ring,
+ * overwriting the oldest ones, so memory is bounded by STACKTRACE_TRACE_NEVENTS
+ * per thread. Rings are written to the JSON file when the thread exits and
+ * when tracing stops. End events left without their begin events after
+ * overwriting are skipped, calls still running get an end event at flush time.
+ *
+ * A ring is detached under its lock before it is written, and events are only
+ * added under the lock while tracing is on, so stacktrace_trace_stop() can flush
+ * rings of running threads and no ring is allocated after it.
+ */
+typedef struct {
+	FILE* stream;
+	size_t nwritten;
+	size_t ndropped;
+	pthread_mutex_t mutex;
+
+	uint64_t start_ticks;
+	uint64_t start_ns;
+} trace_t;
+
+static trace_t trace = { NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER, 0, 0 };
+
+static void trace__lock(stacktrace_t* const st)
+{
+	while(atomic_flag_test_and_set_explicit(&st->events_lock, memory_order_acquire)) {
+		sched_yield();
+	}
+}
+
+static void trace__unlock(stacktrace_t* const st)
+{
+	atomic_flag_clear_explicit(&st->events_lock, memory_order_release);
+}
+
+static void stacktrace__trace_event(stacktrace_t* const st, char const* const func)
+{
+	uint64_t const ticks = timing__ticks();
+
+	trace__lock(st);
+
+	// tracing may be stopped after the caller checked it
+	if(!atomic_load_explicit(&stacktrace__tracing, memory_order_relaxed)) {
+		trace__unlock(st);
+		return;
+	}
+
+	if(st->events == NULL) {
+		st->events = (trace_event_t*)calloc(STACKTRACE_TRACE_NEVENTS, 
+											sizeof(trace_event_t));
+		if(st->events == NULL) {
+			trace__unlock(st);
+			return;
+		}
+		st->nevents = 0;
+	}
+
+	trace_event_t* const event = &st->events[st->nevents & (STACKTRACE_TRACE_NEVENTS - 1)];
+	event->func = func;
+	event->ticks = ticks;
+	++st->nevents;
+
+	trace__unlock(st);
+}
+
+static void trace__write_event(char const* const func, char phase, uint64_t const ticks,
+							   long const tid, double const us_per_tick)
+{
+	double const ts = (double)(ticks - trace.start_ticks) * us_per_tick;
+
+	fputs(trace.nwritten == 0 ? "\n" : ",\n", trace.stream);
+	if(func != NULL) {
+		fprintf(trace.stream, "{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,"
+				"\"pid\":%i,\"tid\":%li}", func, phase, ts, (int)getpid(), tid);
+	}
+	else {
+		fprintf(trace.stream, "{\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%i,\"tid\":%li}",
+				phase, ts, (int)getpid(), tid);
+	}
+	++trace.nwritten;
+}
+
+// must be called with trace.mutex locked
+static void trace__write_ring(trace_event_t const* const events, size_t const nevents,
+							  long const tid)
+{
+	uint64_t const now = timing__ticks();
+	uint64_t const nticks = now - trace.start_ticks;
+	uint64_t const nns = timing__ns() - trace.start_ns;
+	double const us_per_tick = nticks == 0 ? 0.0 : (double)nns / (double)nticks / 1e3;
+
+	size_t first = 0;
+	if(nevents > STACKTRACE_TRACE_NEVENTS) {
+		first = nevents - STACKTRACE_TRACE_NEVENTS;
+		trace.ndropped += first;
+	}
+
+	size_t nopen = 0;
+	for(size_t i = first; i < nevents; ++i) {
+		trace_event_t const* const event = &events[i & (STACKTRACE_TRACE_NEVENTS - 1)];
+		if(event->func != NULL) {
+			trace__write_event(event->func, 'B', event->ticks, tid, us_per_tick);
+			++nopen;
+		}
+		else if(nopen != 0) {
+			trace__write_event(NULL, 'E', event->ticks, tid, us_per_tick);
+			--nopen;
+		}
+	}
+	for(; nopen != 0; --nopen) {
+		trace__write_event(NULL, 'E', now, tid, us_per_tick);
+	}
+}
+
+// takes the ring from the stacktrace, returns NULL if there is none
+static trace_event_t* trace__detach(stacktrace_t* const st, size_t* const pnevents)
+{
+	trace__lock(st);
+	trace_event_t* const events = st->events;
+	*pnevents = st->nevents;
+	st->events = NULL;
+	st->nevents = 0;
+	trace__unlock(st);
+
+	return events;
+}
+
+static void stacktrace__trace_flush(stacktrace_t* const st)
+{
+	// detached first: stacktrace_trace_stop() takes ring locks under trace.mutex
+	size_t nevents = 0;
+	trace_event_t* const events = trace__detach(st, &nevents);
+	if(events == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&trace.mutex);
+	if(trace.stream != NULL) {
+		trace__write_ring(events, nevents, st->tid);
+	}
+	pthread_mutex_unlock(&trace.mutex);
+
+	free(events);
+}
+
+int const stacktrace_trace_start(char const* const filename)
+{
+	ASSERT(filename != NULL);
+
+	pthread_mutex_lock(&trace.mutex);
+
+	if(trace.stream != NULL) {
+		pthread_mutex_unlock(&trace.mutex);
+		return 0;
+	}
+
+	trace.stream = fopen(filename, "w");
+	if(trace.stream == NULL) {
+		pthread_mutex_unlock(&trace.mutex);
+		return 0;
+	}
+
+	static int atexit_flag = 0;
+	if(!atexit_flag) {
+		atexit(stacktrace_trace_stop);
+		atexit_flag = 1;
+	}
+
+	fputs("{\"traceEvents\":[", trace.stream);
+	trace.nwritten = 0;
+	trace.ndropped = 0;
+	trace.start_ticks = timing__ticks();
+	trace.start_ns = timing__ns();
+
+	atomic_store(&stacktrace__tracing, 1);
+	pthread_mutex_unlock(&trace.mutex);
+	return 1;
+}
+
+void stacktrace_trace_stop()
+{
+	if(!atomic_exchange(&stacktrace__tracing, 0)) {
+		return;
+	}
+
+	pthread_mutex_lock(&trace.mutex);
+	for(size_t i = 0; i < STACKTRACE_MAXTHREADS; ++i) {
+		stacktrace_t* const st = &stacktrace__registry[i];
+		if(!atomic_load(&st->busy)) {
+			continue;
+		}
+
+		size_t nevents = 0;
+		trace_event_t* const events = trace__detach(st, &nevents);
+		if(events != NULL) {
+			trace__write_ring(events, nevents, st->tid);
+			free(events);
+		}
+	}
+
+	fputs("\n],\"displayTimeUnit\":\"ms\"}\n", trace.stream);
+	if(fclose(trace.stream) != 0) {
+		fprintf(stderr, "stacktrace trace: failed to write trace file\n");
+	}
+	trace.stream = NULL;
+
+	if(trace.ndropped != 0) {
+		fprintf(stderr, "stacktrace trace: %zu oldest events were dropped, increase "
+				"STACKTRACE_TRACE_NEVENTS\n", trace.ndropped);
+	}
+	pthread_mutex_unlock(&trace.mutex);
+}
+
+static void stacktrace__setup_env()
+{
+	char const* const filename = getenv("TTRACK_PROFILE");
+	if(filename != NULL && *filename != '\0') {
+		unsigned frequency = STACKTRACE_PROFILE_FREQUENCY;
+		char const* const freqstr = getenv("TTRACK_PROFILE_FREQ");
+		if(freqstr != NULL && atoi(freqstr) > 0) {
+			frequency = (unsigned)atoi(freqstr);
+		}
+
+		if(!stacktrace_profile_start(filename, frequency)) {
+			fprintf(stderr, "stacktrace profiler: failed to start\n");
+		}
+	}
+
+	char const* const timing_filename = getenv("TTRACK_TIMING");
+	if(timing_filename != NULL && *timing_filename != '\0') {
+		if(!stacktrace_timing_start(strcmp(timing_filename, "-") == 0 ? NULL 
+										: timing_filename)) {
+			fprintf(stderr, "stacktrace timing: failed to start\n");
+		}
+	}
+
+	char const* const trace_filename = getenv("TTRACK_TRACE");
+	if(trace_filename != NULL && *trace_filename != '\0') {
+		if(!stacktrace_trace_start(trace_filename)) {
+			fprintf(stderr, "stacktrace trace: failed to start\n");
+		}
+	}
+}
@@ -18,6 +18,13 @@
  * Если не определен макрос STACKTRACE или наоборот определен NDEBUG не делает ничего.
  */
 
+/* \def STACKTRACE_PRINT_ALL
+ * \brief Распечатывает трассировки стеков вызовов всех потоков в режиме трассировки
+ * 		и отладки.
+ *
+ * Если не определен макрос STACKTRACE или наоборот определен NDEBUG не делает ничего.
+ */
+
 /* \def STACKTRACE_PUSH
  * \brief Помещает данные текущей функции в стек вызовов.
  *
@@ -51,6 +58,7 @@
 
 #if !defined NDEBUG && defined STACKTRACE
 #	define STACKTRACE_PRINT stacktrace_print(stderr);
+#	define STACKTRACE_PRINT_ALL stacktrace_print_all(stderr);
 
 #	define STACKTRACE_PUSH stacktrace__push(__func__, __FILE__, __LINE__);
 #	define STACKTRACE_POP  stacktrace__pop();
@@ -66,6 +74,7 @@
 
 #else /* !defined NDEBUG && defined STACKTRACE */
 #	define STACKTRACE_PRINT
+#	define STACKTRACE_PRINT_ALL
 
 #	define STACKTRACE_PUSH
 #	define STACKTRACE_POP
@@ -149,6 +158,81 @@ void dbg__message(char const* const file, int line, FILE* const stream,
 		assert(ferror(stream) == 0);	\
 	} while(0)
 
+/** \def STACKTRACE_MAXDEPTH
+ * \brief Максимальное количество кадров стека вызовов, хранимых для каждого потока.
+ *
+ * Место под кадры выделяется заранее, поэтому $_ и $$ не обращаются к куче.
+ * Вызовы глубже этого значения не сохраняются, а только подсчитываются.
+ *
+ * Может быть переопределено при компиляции библиотеки.
+ */
+
+#ifndef STACKTRACE_MAXDEPTH
+#	define STACKTRACE_MAXDEPTH 256
+#endif
+
+/** \def STACKTRACE_MAXTHREADS
+ * \brief Максимальное количество одновременно живущих потоков, стеки вызовов которых
+ * 		доступны для stacktrace_print_all.
+ *
+ * Поток получает место в реестре при первом вызове $_ и освобождает его при
+ * завершении. Потоки сверх этого количества трассируются, но в реестр не попадают.
+ *
+ * Может быть переопределено при компиляции библиотеки.
+ */
+
+#ifndef STACKTRACE_MAXTHREADS
+#	define STACKTRACE_MAXTHREADS 64
+#endif
+
+/** \def STACKTRACE_PROFILE_BUFSIZE
+ * \brief Размер буфера сэмплов профилировщика в указателях.
+ *
+ * Каждый сэмпл занимает глубину стека плюс один указатель. Сэмплы, не
+ * поместившиеся в буфер, теряются и подсчитываются.
+ *
+ * Может быть переопределено при компиляции библиотеки.
+ */
+
+#ifndef STACKTRACE_PROFILE_BUFSIZE
+#	define STACKTRACE_PROFILE_BUFSIZE (1024 * 1024)
+#endif
+
+/** \def STACKTRACE_PROFILE_FREQUENCY
+ * \brief Частота сэмплирования профилировщика по умолчанию в герцах.
+ *
+ * Может быть переопределено при компиляции библиотеки.
+ */
+
+#ifndef STACKTRACE_PROFILE_FREQUENCY
+#	define STACKTRACE_PROFILE_FREQUENCY 1000
+#endif
+
+/** \def STACKTRACE_TIMING_NFUNCS
+ * \brief Размер таблицы статистики по функциям в режиме точных замеров времени.
+ *
+ * Должно быть степенью двойки. Функции, не поместившиеся в таблицу, не учитываются.
+ *
+ * Может быть переопределено при компиляции библиотеки.
+ */
+
+#ifndef STACKTRACE_TIMING_NFUNCS
+#	define STACKTRACE_TIMING_NFUNCS 4096
+#endif
+
+/** \def STACKTRACE_TRACE_NEVENTS
+ * \brief Размер кольцевого буфера событий трассировки каждого потока.
+ *
+ * Должно быть степенью двойки. При переполнении самые старые события
+ * перезаписываются.
+ *
+ * Может быть переопределено при компиляции библиотеки.
+ */
+
+#ifndef STACKTRACE_TRACE_NEVENTS
+#	define STACKTRACE_TRACE_NEVENTS (64 * 1024)
+#endif
+
 /** \def DUMP_BUFSIZE
  * \brief Максимально возможное количество напечатанных символов за один вызов
  * 		функции dump.
@@ -249,6 +333,88 @@ void stacktrace__dump(char const* funcname, char const* filename, size_t nline);
 	stacktrace__dump(__func__, __FILE__, __LINE__)
 
 void stacktrace_print(FILE* const stream);
+void stacktrace_print_all(FILE* const stream);
+
+/**
+ * \brief Запускает сэмплирующий профилировщик, построенный на стеке вызовов $_ / $$.
+ *
+ * По сигналу SIGPROF с частотой frequency (в герцах процессорного времени)
+ * сохраняет текущий стек вызовов прерванного потока. При вызове
+ * stacktrace_profile_stop() или при завершении программы записывает в файл
+ * filename свернутые стеки ("main;parser_pass;find_cmd_parser 42") в формате
+ * flamegraph.pl и совместимых инструментов.
+ *
+ * Программу с трассировкой стека можно профилировать и без изменения кода:
+ * если задана переменная окружения TTRACK_PROFILE, профилировщик запускается
+ * при первом $_ и пишет в указанный в ней файл. Частота берется из
+ * TTRACK_PROFILE_FREQ или STACKTRACE_PROFILE_FREQUENCY.
+ *
+ * \param[in] filename имя выходного файла. Должно быть ненулевым и жить до остановки.
+ * \param[in] frequency частота сэмплирования в герцах. Не должна быть нулевой.
+ *
+ * \return 1 в случае успеха, 0 если профилировщик уже запущен или произошла ошибка.
+ */
+int const stacktrace_profile_start(char const* const filename, unsigned const frequency);
+
+/**
+ * \brief Останавливает профилировщик и записывает результаты.
+ *
+ * Если профилировщик не запущен не делает ничего.
+ */
+void stacktrace_profile_stop();
+
+/**
+ * \brief Включает точный замер времени функций, отмеченных $_ и $$.
+ *
+ * Для каждой функции подсчитывает количество вызовов, включающее время (вместе с
+ * вызванными функциями, рекурсивные вызовы учитываются один раз) и
+ * исключающее время (только тело функции). Время измеряется при помощи rdtsc.
+ * При вызове stacktrace_timing_stop() или при завершении программы записывает
+ * в файл filename таблицу, отсортированную по исключающему времени.
+ *
+ * Если задана переменная окружения TTRACK_TIMING, замер включается при первом
+ * $_ и пишет в указанный в ней файл ("-" - стандартный поток ошибок).
+ *
+ * \param[in] filename имя выходного файла или NULL для stderr. Должно жить до
+ * 		остановки замера.
+ *
+ * \return 1 в случае успеха, 0 если замер уже включен или не хватило памяти.
+ */
+int const stacktrace_timing_start(char const* const filename);
+
+/**
+ * \brief Выключает замер времени и записывает таблицу.
+ *
+ * Вызовы, не завершившиеся к моменту остановки, не учитываются. Если замер
+ * не включен не делает ничего.
+ */
+void stacktrace_timing_stop();
+
+/**
+ * \brief Включает запись входов и выходов из функций, отмеченных $_ и $$, в формате
+ * 		Chrome trace-event JSON (открывается в Perfetto и chrome://tracing).
+ *
+ * Каждый поток пишет события в собственный кольцевой буфер на
+ * STACKTRACE_TRACE_NEVENTS событий, при переполнении старые события теряются.
+ * Буферы сбрасываются в файл filename при завершении потока, при вызове
+ * stacktrace_trace_stop() и при завершении программы.
+ *
+ * Если задана переменная окружения TTRACK_TRACE, запись включается при первом
+ * $_ и пишет в указанный в ней файл.
+ *
+ * \param[in] filename имя выходного файла. Должно быть ненулевым.
+ *
+ * \return 1 в случае успеха, 0 если запись уже включена или файл не открылся.
+ */
+int const stacktrace_trace_start(char const* const filename);
+
+/**
+ * \brief Выключает трассировку и дописывает файл.
+ *
+ * Остальные потоки не должны выполнять $_ и $$ во время вызова. Если трассировка
+ * не включена не делает ничего.
+ */
+void stacktrace_trace_stop();
 
 #endif
 
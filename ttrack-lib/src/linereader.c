@@ -0,0 +1,174 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "dbg.h"
+#include "linereader.h"
+
+static char const* const LINEREADER__ERRSTR[LINEREADER_NERRORS] = {
+	"ok",
+	"end of file",
+	"out of memory",
+	"input/output error",
+	"invalid argument"
+};
+
+char const* const linereader_errstr(linereader_err_t const err)
+{$_
+	if(err < 0 || err >= LINEREADER_NERRORS) {
+		RETURN(NULL);
+	}
+	RETURN(LINEREADER__ERRSTR[err]);
+}
+
+static linereader_err_t const linereader__set_error(linereader_t* const reader, 
+													linereader_err_t const err)
+{$_
+	reader->err = err;
+	RETURN(err);
+}
+
+linereader_err_t const linereader_init(linereader_t* const reader, int const fd, 
+									   size_t const capacity, char const sep, 
+									   int const close_flag)
+{$_
+	ASSERT(reader != NULL);
+
+	if(fd < 0) {
+		RETURN(LINEREADER_ERR_ARG);
+	}
+
+	reader->fd = fd;
+	reader->close_flag = close_flag;
+	reader->sep = sep;
+	reader->capacity = capacity != 0 ? capacity : LINEREADER_CAPACITY;
+	reader->buf = (char*)malloc(2 * reader->capacity);
+	if(reader->buf == NULL) {
+		RETURN(LINEREADER_ERR_MEMORY);
+	}
+
+	reader->pos = reader->buf + reader->capacity;
+	reader->end = reader->pos;
+	reader->eof = 0;
+	reader->piece = 0;
+	reader->err = LINEREADER_ERR_OK;
+
+	// fails for pipes, it's only a hint
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	RETURN(LINEREADER_ERR_OK);
+}
+
+linereader_err_t const linereader_open(linereader_t* const reader, char const* const fname,
+									   size_t const capacity, char const sep)
+{$_
+	ASSERT(reader != NULL);
+	ASSERT(fname != NULL);
+
+	int const fd = open(fname, O_RDONLY);
+	if(fd == -1) {
+		RETURN(LINEREADER_ERR_IO);
+	}
+
+	linereader_err_t const err = linereader_init(reader, fd, capacity, sep, 1);
+	if(err != LINEREADER_ERR_OK) {
+		close(fd);
+	}
+	RETURN(err);
+}
+
+void linereader_free(linereader_t* const reader)
+{$_
+	ASSERT(reader != NULL);
+
+	free(reader->buf);
+	reader->buf = NULL;
+
+	if(reader->close_flag) {
+		close(reader->fd);
+	}
+	reader->fd = -1;
+$$
+}
+
+// moves the unfinished line before the second half and reads the second half
+static linereader_err_t const linereader__fill(linereader_t* const reader)
+{$_
+	char* const half = reader->buf + reader->capacity;
+	size_t const tail = (size_t)(reader->end - reader->pos);
+	ASSERT(tail <= reader->capacity);
+
+	memmove(half - tail, reader->pos, tail);
+	reader->pos = half - tail;
+
+	ssize_t n = 0;
+	do {
+		n = read(reader->fd, half, reader->capacity);
+	} while(n == -1 && errno == EINTR);
+
+	if(n == -1) {
+		reader->end = half;
+		RETURN(linereader__set_error(reader, LINEREADER_ERR_IO));
+	}
+
+	reader->end = half + n;
+	reader->eof = n == 0;
+	RETURN(LINEREADER_ERR_OK);
+}
+
+linereader_err_t const linereader_next(linereader_t* const reader, strv_t* const line)
+{$_
+	ASSERT(reader != NULL);
+	ASSERT(reader->buf != NULL);
+	ASSERT(line != NULL);
+
+	if(reader->err != LINEREADER_ERR_OK) {
+		RETURN(reader->err);
+	}
+
+	char const* sep = NULL;
+	// the number of bytes already searched
+	size_t searched = 0;
+	for(;;) {
+		size_t const size = (size_t)(reader->end - reader->pos);
+		sep = (char const*)memchr(reader->pos + searched, reader->sep, size - searched);
+		if(sep != NULL && sep == reader->pos && reader->piece) {
+			// the separator ends the long line returned in pieces, it is not an empty line
+			reader->pos = sep + 1;
+			reader->piece = 0;
+			continue;
+		}
+		if(sep != NULL) {
+			*line = strv_init(reader->pos, sep);
+			reader->pos = sep + 1;
+			reader->piece = 0;
+			RETURN(LINEREADER_ERR_OK);
+		}
+		searched = size;
+
+		if(reader->eof) {
+			break;
+		}
+		if(size > reader->capacity) {
+			// the line doesn't fit, the piece is returned as a line
+			*line = strv_init(reader->pos, reader->end);
+			reader->pos = reader->end;
+			reader->piece = 1;
+			RETURN(LINEREADER_ERR_OK);
+		}
+
+		linereader_err_t const err = linereader__fill(reader);
+		if(err != LINEREADER_ERR_OK) {
+			RETURN(err);
+		}
+	}
+
+	// the last line without the separator
+	if(reader->pos == reader->end) {
+		RETURN(LINEREADER_ERR_EOF);
+	}
+	*line = strv_init(reader->pos, reader->end);
+	reader->pos = reader->end;
+	RETURN(LINEREADER_ERR_OK);
+}
@@ -1,6 +1,20 @@
 #include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <wchar.h>
+#include <unistd.h>
+#include <sys/syscall.h>
 #include "log.h"
 #include "dbg.h"
+#include "comp.h"
+#include "text.h"
 
 #if defined LOGGER_INPUT_ASSERT
 #	define LOGGER_ON_INPUT_ASSERT(code) do { code } while(0)
@@ -24,11 +38,16 @@ static char const* const LOGGER__ERRORSTR[LOGGER_NERRORS] = {
 	"stdio internal error",
 	"invalid argument",
 	"log not finished (missed logger_end() call)",
+	"log not started (missed logger_start() call)",
 	"invalid log level value",
 	"invalid log stream",
 	"logger instance pointer is null",
 	"reinitiallization probability",
-	"invalid ignore flag"
+	"invalid ignore flag",
+	"out of memory",
+	"failed to start logger thread",
+	"invalid binary log",
+	"too many unfinished records of async loggers in this thread"
 };
 static char const* const LOGGER__IGNFLAGSTR[4] = {
 	"no logging",
@@ -98,6 +117,645 @@ char const* const logger__ignflagstr(int ignflag)
 	}
 }
 
+/*
+ * Asynchronous mode. Records are composed in the calling thread's own buffer
+ * and then copied into a bounded MPSC ring (sequence numbered slots, producers
+ * claim a slot with CAS on head, no locks). The logger thread collects ready
+ * records into one large buffer and writes it with a single fwrite when the
+ * buffer is full or the ring becomes empty.
+ */
+typedef struct {
+	atomic_size_t seq;
+	size_t size;
+	char data[LOGGER_RECORD_SIZE];
+} logger__slot_t;
+
+struct logger_async_s {
+	logger__slot_t* slots;
+	size_t mask;
+	logger_overflow_t overflow;
+
+	atomic_size_t head;
+	atomic_size_t nconsumed;
+	atomic_size_t ndropped;
+	size_t ndropped_reported;
+	atomic_int stop;
+
+	pthread_t thread;
+	size_t batch_size;
+	char batch[LOGGER_ASYNC_BATCH_SIZE];
+};
+
+// formats of the binary mode defined by a record that is not written yet
+#define LOGGER__NPENDING 8
+
+typedef struct {
+	size_t n;
+	char const* formats[LOGGER__NPENDING];
+} logger__pending_t;
+
+// record being composed by this thread between logger_start() and logger_stop()
+typedef struct {
+	logger_t const* logger;
+	int ignore_flag;
+	size_t size;
+	char data[LOGGER_RECORD_SIZE];
+	logger__pending_t pending;
+} logger__record_t;
+
+// one record per async logger, a record is free when its ignore flag is LOGGER__NO_LOG
+static _Thread_local logger__record_t logger__records[LOGGER_ASYNC_NRECORDS];
+// stands for a free record when all of them are taken by other loggers
+static _Thread_local logger__record_t logger__no_record;
+
+// leaves place for LOGGER_NO_COLOR and '\0' at the end of the record
+#define LOGGER__RECORD_LIMIT (LOGGER_RECORD_SIZE - sizeof(LOGGER_NO_COLOR))
+
+static size_t const logger__vappend(char* const data, size_t const size, 
+									char const* const format, va_list args)
+{
+	if(size + 1 >= LOGGER__RECORD_LIMIT) {
+		return size;
+	}
+
+	int const n = vsnprintf(data + size, LOGGER__RECORD_LIMIT - size, format, args);
+	if(n < 0) {
+		return size;
+	}
+	if((size_t)n >= LOGGER__RECORD_LIMIT - size) {
+		return LOGGER__RECORD_LIMIT - 1;
+	}
+	return size + (size_t)n;
+}
+
+static size_t const logger__append(char* const data, size_t const size, 
+								   char const* const format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	size_t const new_size = logger__vappend(data, size, format, args);
+	va_end(args);
+
+	return new_size;
+}
+
+static size_t const logger__close(char* const data, size_t const size)
+{
+	memcpy(data + size, LOGGER_NO_COLOR, sizeof(LOGGER_NO_COLOR) - 1);
+	return size + sizeof(LOGGER_NO_COLOR) - 1;
+}
+
+/*
+ * Record headers: "[date time.ms][thread id][LEVEL]". The time is taken from
+ * the coarse clock (vDSO, no system call, resolution of a few milliseconds),
+ * the calendar part is formatted once a second per thread and the thread id
+ * is asked once per thread.
+ */
+static uint64_t const logger__clock(clockid_t const clock)
+{
+	struct timespec ts;
+	clock_gettime(clock, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static long const logger__tid()
+{
+	static _Thread_local long tid = 0;
+	if(tid == 0) {
+		tid = (long)syscall(SYS_gettid);
+	}
+	return tid;
+}
+
+typedef struct {
+	time_t sec;
+	char str[32];
+} logger__time_cache_t;
+
+static _Thread_local logger__time_cache_t logger__time_cache = { (time_t)-1, "" };
+
+static size_t const logger__header(char* const data, logger_level_t const level,
+								   uint64_t const time, long const tid)
+{
+	time_t const sec = (time_t)(time / 1000000000u);
+	if(sec != logger__time_cache.sec) {
+		struct tm tm;
+		if(localtime_r(&sec, &tm) == NULL || strftime(logger__time_cache.str, 
+				sizeof(logger__time_cache.str), "%Y-%m-%d %H:%M:%S", &tm) == 0) {
+			logger__time_cache.str[0] = '\0';
+		}
+		logger__time_cache.sec = sec;
+	}
+
+	char const* const levelstr = logger_levelstr(level);
+	return logger__append(data, 0, "%s[%s.%03u][%li][%s]\n", logger__colorstr(level), 
+						  logger__time_cache.str, (unsigned)(time / 1000000u % 1000u),
+						  tid, levelstr != NULL ? levelstr : "?");
+}
+
+/*
+ * Binary mode. Instead of formatting, a record is stored as a sequence of
+ * tagged items with the format string pointer and the raw argument values,
+ * logger_decode() does the formatting later. Argument types are taken from
+ * the conversion specifications, so the format string is only scanned.
+ *
+ *	'M' "TTLOGB1"				stream header
+ *	'F' u64 id, u32 len, text	format string definition, id is its address
+ *	'S' u8 level, u64 time,		logger_start()
+ *		i64 thread id
+ *	'P' u64 id, u32 n, args[n]	logger_printf(): integers are stored as 64-bit,
+ *								doubles as double, strings as u32 len + bytes,
+ *								%m as errno (64-bit); %n is ignored
+ *	'T'							the rest of the record didn't fit
+ *	'D' u64 n					n records were dropped by the async logger
+ *	'E'							logger_stop()
+ *
+ * A format is defined in the record of its first use, before the 'P' item, and
+ * it is considered defined once the record is written or queued: a dropped
+ * record doesn't leave its format undefined. Records of other threads may reach
+ * the stream first or define the format again, so the decoder collects
+ * definitions first. Formats that don't fit into a record are written as 'T'.
+ */
+#define LOGGER__BIN_MAGIC		"MTTLOGB1"
+#define LOGGER__BIN_FORMAT		'F'
+#define LOGGER__BIN_START		'S'
+#define LOGGER__BIN_PRINTF		'P'
+#define LOGGER__BIN_TRUNCATED	'T'
+#define LOGGER__BIN_STOP		'E'
+#define LOGGER__BIN_DROPPED		'D'
+
+struct logger_binary_s {
+	_Atomic(char const*) formats[LOGGER_BINARY_NFORMATS];
+};
+
+typedef enum {
+	LOGGER__ARG_NONE = 0,
+	LOGGER__ARG_INT,
+	LOGGER__ARG_UINT,
+	LOGGER__ARG_DOUBLE,
+	LOGGER__ARG_LDOUBLE,
+	LOGGER__ARG_STRING,
+	LOGGER__ARG_POINTER,
+	LOGGER__ARG_ERRNO,		// %m, takes no argument
+	LOGGER__ARG_COUNT		// %n, the pointer is taken but nothing is stored
+} logger__arg_t;
+
+typedef struct {
+	char const* begin;		// '%'
+	char const* precision;	// '.' or the length modifier if there is no precision
+	char const* length;		// length modifier or the conversion
+	char const* end;		// after the conversion
+
+	int width_arg;			// width is '*'
+	int precision_arg;		// precision is '*'
+	long precision_value;	// -1 if there is no literal precision
+	logger__arg_t arg;
+} logger__spec_t;
+
+// finds the next conversion specification, "%%" is not a specification
+static char const* logger__next_spec(char const* format, logger__spec_t* const spec)
+{
+	for(format = strchr(format, '%'); format != NULL; format = strchr(format + 2, '%')) {
+		if(format[1] != '%') {
+			break;
+		}
+	}
+	if(format == NULL) {
+		return NULL;
+	}
+
+	spec->begin = format++;
+	format += strspn(format, "-+ #0'");
+
+	spec->width_arg = *format == '*';
+	if(spec->width_arg) {
+		++format;
+	}
+	else {
+		format += strspn(format, "0123456789");
+	}
+
+	spec->precision = format;
+	spec->precision_arg = 0;
+	spec->precision_value = -1;
+	if(*format == '.') {
+		++format;
+		if(*format == '*') {
+			spec->precision_arg = 1;
+			++format;
+		}
+		else {
+			spec->precision_value = strtol(format, NULL, 10);
+			format += strspn(format, "0123456789");
+		}
+	}
+
+	spec->length = format;
+	format += strspn(format, "hlLqjzt");
+
+	int const is_long = format - spec->length == 1 && *spec->length == 'l';
+	int const is_long_double = format - spec->length == 1 && *spec->length == 'L';
+
+	switch(*format) {
+	case 'd': case 'i':
+		spec->arg = LOGGER__ARG_INT;
+		break;
+	case 'u': case 'o': case 'x': case 'X':
+		spec->arg = LOGGER__ARG_UINT;
+		break;
+	case 'c':
+		spec->arg = is_long ? LOGGER__ARG_UINT : LOGGER__ARG_INT;
+		break;
+	case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+		spec->arg = is_long_double ? LOGGER__ARG_LDOUBLE : LOGGER__ARG_DOUBLE;
+		break;
+	case 's':
+		spec->arg = is_long ? LOGGER__ARG_POINTER : LOGGER__ARG_STRING;
+		break;
+	case 'p':
+		spec->arg = LOGGER__ARG_POINTER;
+		break;
+	case 'm':
+		spec->arg = LOGGER__ARG_ERRNO;
+		break;
+	case 'n':
+		spec->arg = LOGGER__ARG_COUNT;
+		break;
+	default:
+		// unknown conversions take no argument
+		spec->arg = LOGGER__ARG_NONE;
+		break;
+	}
+
+	spec->end = *format == '\0' ? format : format + 1;
+	return spec->begin;
+}
+
+typedef struct {
+	char* data;
+	size_t size;
+	size_t limit;
+	int overflow;
+} logger__buf_t;
+
+static void logger__put(logger__buf_t* const buf, void const* const src, size_t const n)
+{
+	if(buf->overflow || buf->size + n > buf->limit) {
+		buf->overflow = 1;
+		return;
+	}
+	memcpy(buf->data + buf->size, src, n);
+	buf->size += n;
+}
+
+static void logger__put_tag(logger__buf_t* const buf, char const tag)
+{
+	logger__put(buf, &tag, 1);
+}
+
+static void logger__put_u64(logger__buf_t* const buf, uint64_t const value)
+{
+	logger__put(buf, &value, sizeof(value));
+}
+
+static void logger__put_u32(logger__buf_t* const buf, uint32_t const value)
+{
+	logger__put(buf, &value, sizeof(value));
+}
+
+// returns 1 if a record defining the format already reached the stream
+static int const logger__binary_known(struct logger_binary_s const* const binary, 
+									  char const* const format)
+{
+	size_t const mask = LOGGER_BINARY_NFORMATS - 1;
+	size_t idx = (size_t)(((uintptr_t)format >> 3) * 0x9E3779B97F4A7C15ull) & mask;
+
+	for(size_t i = 0; i < LOGGER_BINARY_NFORMATS; ++i, idx = (idx + 1) & mask) {
+		char const* const known = atomic_load_explicit(&binary->formats[idx], 
+													   memory_order_relaxed);
+		if(known == format) {
+			return 1;
+		}
+		if(known == NULL) {
+			return 0;
+		}
+	}
+	return 0;
+}
+
+// remembers that the format reached the stream
+static void logger__binary_learn(struct logger_binary_s* const binary, 
+								 char const* const format)
+{
+	size_t const mask = LOGGER_BINARY_NFORMATS - 1;
+	size_t idx = (size_t)(((uintptr_t)format >> 3) * 0x9E3779B97F4A7C15ull) & mask;
+
+	for(size_t i = 0; i < LOGGER_BINARY_NFORMATS; ++i, idx = (idx + 1) & mask) {
+		char const* known = atomic_load_explicit(&binary->formats[idx], 
+												 memory_order_relaxed);
+		if(known == NULL && 
+		   atomic_compare_exchange_strong(&binary->formats[idx], &known, format)) {
+			return;
+		}
+		if(known == format) {
+			return;
+		}
+	}
+
+	// the table is full, the format is defined every time
+}
+
+// remembers the formats defined by a record once it is written or queued
+static void logger__binary_commit(logger_t* const logger, 
+								  logger__pending_t* const pending)
+{
+	if(logger->binary != NULL) {
+		for(size_t i = 0; i < pending->n; ++i) {
+			logger__binary_learn(logger->binary, pending->formats[i]);
+		}
+	}
+	pending->n = 0;
+}
+
+static size_t const logger__binary_vprintf(logger_t* const logger, char* const data,
+										   size_t const size, char const* const format,
+										   va_list args, logger__pending_t* const pending)
+{
+	int const error = errno;
+	logger__buf_t buf = { data, size, LOGGER__RECORD_LIMIT, 0 };
+
+	// a new format is defined in the same record, so it reaches the stream together
+	// with its first use or not at all; a format that doesn't fit is not defined
+	int const define = !logger__binary_known(logger->binary, format);
+	if(define) {
+		size_t const len = strlen(format);
+		logger__put_tag(&buf, LOGGER__BIN_FORMAT);
+		logger__put_u64(&buf, (uint64_t)(uintptr_t)format);
+		logger__put_u32(&buf, (uint32_t)len);
+		logger__put(&buf, format, len);
+	}
+
+	logger__put_tag(&buf, LOGGER__BIN_PRINTF);
+	logger__put_u64(&buf, (uint64_t)(uintptr_t)format);
+
+	size_t const nbytes_pos = buf.size;
+	logger__put_u32(&buf, 0);
+
+	logger__spec_t spec;
+	for(char const* rover = logger__next_spec(format, &spec); rover != NULL;
+		rover = logger__next_spec(spec.end, &spec)) 
+	{
+		if(spec.width_arg) {
+			logger__put_u64(&buf, (uint64_t)(int64_t)va_arg(args, int));
+		}
+		long precision = spec.precision_value;
+		if(spec.precision_arg) {
+			precision = va_arg(args, int);
+			logger__put_u64(&buf, (uint64_t)(int64_t)precision);
+		}
+
+		size_t const length = (size_t)(spec.end - 1 - spec.length);
+		char const l0 = length > 0 ? spec.length[0] : '\0';
+		char const l1 = length > 1 ? spec.length[1] : '\0';
+
+		switch(spec.arg) {
+		case LOGGER__ARG_INT:
+			if(l0 == 'l' && l1 == 'l')	{ logger__put_u64(&buf, (uint64_t)va_arg(args, long long)); }
+			else if(l0 == 'l')			{ logger__put_u64(&buf, (uint64_t)va_arg(args, long)); }
+			else if(l0 == 'j')			{ logger__put_u64(&buf, (uint64_t)va_arg(args, intmax_t)); }
+			else if(l0 == 'z' || l0 == 't') {
+				logger__put_u64(&buf, (uint64_t)va_arg(args, ptrdiff_t));
+			}
+			else						{ logger__put_u64(&buf, (uint64_t)va_arg(args, int)); }
+			break;
+
+		case LOGGER__ARG_UINT:
+			if(l0 == 'l' && l1 == 'l')	{ logger__put_u64(&buf, va_arg(args, unsigned long long)); }
+			else if(l0 == 'l')			{ logger__put_u64(&buf, va_arg(args, unsigned long)); }
+			else if(l0 == 'j')			{ logger__put_u64(&buf, va_arg(args, uintmax_t)); }
+			else if(l0 == 'z' || l0 == 't') {
+				logger__put_u64(&buf, va_arg(args, size_t));
+			}
+			else						{ logger__put_u64(&buf, va_arg(args, unsigned)); }
+			break;
+
+		case LOGGER__ARG_DOUBLE: {
+			double const value = va_arg(args, double);
+			logger__put(&buf, &value, sizeof(value));
+			break;
+		}
+		case LOGGER__ARG_LDOUBLE: {
+			long double const value = va_arg(args, long double);
+			logger__put(&buf, &value, sizeof(value));
+			break;
+		}
+		case LOGGER__ARG_STRING: {
+			char const* str = va_arg(args, char const*);
+			if(str == NULL) {
+				str = "(null)";
+			}
+			size_t const len = precision >= 0 ? strnlen(str, (size_t)precision) 
+											  : strlen(str);
+			logger__put_u32(&buf, (uint32_t)len);
+			logger__put(&buf, str, len);
+			break;
+		}
+		case LOGGER__ARG_POINTER:
+			logger__put_u64(&buf, (uint64_t)(uintptr_t)va_arg(args, void*));
+			break;
+
+		case LOGGER__ARG_ERRNO:
+			logger__put_u64(&buf, (uint64_t)(int64_t)error);
+			break;
+
+		case LOGGER__ARG_COUNT:
+			// the number of characters is not known until decoding
+			(void)va_arg(args, void*);
+			break;
+
+		case LOGGER__ARG_NONE:
+			break;
+		}
+	}
+
+	if(buf.overflow) {
+		data[size] = LOGGER__BIN_TRUNCATED;
+		return size + 1;
+	}
+
+	uint32_t const nbytes = (uint32_t)(buf.size - nbytes_pos - sizeof(uint32_t));
+	memcpy(data + nbytes_pos, &nbytes, sizeof(nbytes));
+
+	// if the list is full, the format is defined again by the next record
+	if(define && pending->n < LOGGER__NPENDING) {
+		pending->formats[pending->n++] = format;
+	}
+	return buf.size;
+}
+
+/*
+ * Record builders shared by the synchronous and the asynchronous loggers.
+ */
+static size_t const logger__rec_start(logger_t const* const logger, char* const data,
+									  logger_level_t const level)
+{
+	uint64_t const time = logger__clock(CLOCK_REALTIME_COARSE);
+	long const tid = logger__tid();
+
+	if(logger->binary != NULL) {
+		logger__buf_t buf = { data, 0, LOGGER__RECORD_LIMIT, 0 };
+		logger__put_tag(&buf, LOGGER__BIN_START);
+		logger__put_tag(&buf, (char)level);
+		logger__put_u64(&buf, time);
+		logger__put_u64(&buf, (uint64_t)(int64_t)tid);
+		return buf.size;
+	}
+	return logger__header(data, level, time, tid);
+}
+
+static size_t const logger__rec_vprintf(logger_t* const logger, char* const data,
+										size_t const size, char const* const format,
+										va_list args, logger__pending_t* const pending)
+{
+	if(logger->binary != NULL) {
+		return logger__binary_vprintf(logger, data, size, format, args, pending);
+	}
+	return logger__vappend(data, size, format, args);
+}
+
+static size_t const logger__rec_stop(logger_t const* const logger, char* const data,
+									 size_t const size)
+{
+	if(logger->binary != NULL) {
+		data[size] = LOGGER__BIN_STOP;
+		return size + 1;
+	}
+	return logger__close(data, size);
+}
+
+// returns 0 if the record was dropped
+static int const logger__async_push(struct logger_async_s* const async, 
+									char const* const data, size_t const size)
+{
+	size_t pos = atomic_load_explicit(&async->head, memory_order_relaxed);
+	logger__slot_t* slot = NULL;
+
+	for(;;) {
+		slot = &async->slots[pos & async->mask];
+		size_t const seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+
+		if(seq == pos) {
+			if(atomic_compare_exchange_weak_explicit(&async->head, &pos, pos + 1,
+						memory_order_relaxed, memory_order_relaxed)) {
+				break;
+			}
+		}
+		else if(seq < pos) {
+			// the ring is full
+			if(async->overflow != LOGGER_OVERFLOW_BLOCK) {
+				atomic_fetch_add_explicit(&async->ndropped, 1, memory_order_relaxed);
+				return 0;
+			}
+			sched_yield();
+			pos = atomic_load_explicit(&async->head, memory_order_relaxed);
+		}
+		else {
+			pos = atomic_load_explicit(&async->head, memory_order_relaxed);
+		}
+	}
+
+	memcpy(slot->data, data, size);
+	slot->size = size;
+	atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+	return 1;
+}
+
+static void logger__async_write(logger_t* const logger)
+{
+	struct logger_async_s* const async = logger->async;
+
+	if(async->batch_size != 0) {
+		fwrite(async->batch, sizeof(char), async->batch_size, logger->stream);
+		async->batch_size = 0;
+	}
+}
+
+static void* logger__async_main(void* data)
+{
+	logger_t* const logger = (logger_t*)data;
+	struct logger_async_s* const async = logger->async;
+
+	size_t tail = 0;
+	for(;;) {
+		int const stopping = atomic_load_explicit(&async->stop, memory_order_acquire);
+
+		logger__slot_t* const slot = &async->slots[tail & async->mask];
+		if(atomic_load_explicit(&slot->seq, memory_order_acquire) == tail + 1) {
+			if(async->batch_size + slot->size > LOGGER_ASYNC_BATCH_SIZE) {
+				logger__async_write(logger);
+				fflush(logger->stream);
+				atomic_store_explicit(&async->nconsumed, tail, memory_order_release);
+			}
+			memcpy(async->batch + async->batch_size, slot->data, slot->size);
+			async->batch_size += slot->size;
+
+			atomic_store_explicit(&slot->seq, tail + async->mask + 1, memory_order_release);
+			++tail;
+			continue;
+		}
+
+		// the ring is empty
+		size_t const ndropped = atomic_load_explicit(&async->ndropped, 
+													 memory_order_relaxed);
+		if(async->overflow == LOGGER_OVERFLOW_COUNT && 
+		   ndropped != async->ndropped_reported) {
+			logger__async_write(logger);
+			if(logger->binary != NULL) {
+				uint64_t const n = ndropped - async->ndropped_reported;
+				fputc(LOGGER__BIN_DROPPED, logger->stream);
+				fwrite(&n, sizeof(n), 1, logger->stream);
+			}
+			else {
+				fprintf(logger->stream, "[%zu log records dropped]\n", 
+						ndropped - async->ndropped_reported);
+			}
+			async->ndropped_reported = ndropped;
+		}
+
+		logger__async_write(logger);
+		fflush(logger->stream);
+		atomic_store_explicit(&async->nconsumed, tail, memory_order_release);
+
+		if(stopping) {
+			break;
+		}
+
+		struct timespec const delay = { 0, LOGGER_ASYNC_SLEEP_US * 1000L };
+		nanosleep(&delay, NULL);
+	}
+
+	return NULL;
+}
+
+// the record of the async logger started in this thread, otherwise a free one
+static logger__record_t* logger__record(logger_t const* const logger)
+{
+	logger__record_t* free_record = &logger__no_record;
+
+	for(size_t i = 0; i < LOGGER_ASYNC_NRECORDS; ++i) {
+		logger__record_t* const record = &logger__records[i];
+		if(record->ignore_flag == LOGGER__NO_LOG) {
+			if(free_record == &logger__no_record) {
+				free_record = record;
+			}
+		}
+		else if(record->logger == logger) {
+			return record;
+		}
+	}
+	return free_record;
+}
+
 logger_err_t const logger_init(logger_t* const logger, FILE* const stream, 
 							   logger_level_t const min_level, int fclose_flag)
 {$_
@@ -124,14 +782,461 @@ logger_err_t const logger_init(logger_t* const logger, FILE* const stream,
 
 	logger->fclose_flag = fclose_flag;
 	logger->ignore_flag = LOGGER__NO_LOG;
+	logger->async = NULL;
+	logger->binary = NULL;
+
+	RETURN(LOGGER_ERR_OK);
+}
+
+logger_err_t const logger_init_async(logger_t* const logger, FILE* const stream,
+									 logger_level_t const min_level, int fclose_flag,
+									 size_t const capacity, 
+									 logger_overflow_t const overflow)
+{$_
+	LOGGER_ON_INPUT_ASSERT(
+		ASSERT(capacity != 0);
+		ASSERT(overflow >= 0 && overflow < LOGGER_NOVERFLOWS);
+	);
+	LOGGER_ON_INPUT_ERROR(
+		if(capacity == 0 || overflow < 0 || overflow >= LOGGER_NOVERFLOWS) {
+			RETURN(LOGGER_ERR_INVALID_ARGUMENT);
+		}
+	);
+
+	logger_err_t err = logger_init(logger, stream, min_level, fclose_flag);
+	if(err != LOGGER_ERR_OK) {
+		RETURN(err);
+	}
+
+	struct logger_async_s* async = (struct logger_async_s*)calloc(1, 
+		sizeof(struct logger_async_s));
+	if(async == NULL) {
+		RETURN(LOGGER_ERR_MEMORY);
+	}
+
+	size_t const nslots = next_2power(capacity);
+	async->slots = (logger__slot_t*)calloc(nslots, sizeof(logger__slot_t));
+	if(async->slots == NULL) {
+		free(async);
+		RETURN(LOGGER_ERR_MEMORY);
+	}
+	for(size_t i = 0; i < nslots; ++i) {
+		atomic_init(&async->slots[i].seq, i);
+	}
+
+	async->mask = nslots - 1;
+	async->overflow = overflow;
+	logger->async = async;
+
+	if(pthread_create(&async->thread, NULL, logger__async_main, logger) != 0) {
+		free(async->slots);
+		free(async);
+		logger->async = NULL;
+		RETURN(LOGGER_ERR_THREAD);
+	}
 
 	RETURN(LOGGER_ERR_OK);
 }
 
+logger_err_t const logger_flush(logger_t* const logger)
+{$_
+	logger_assert(logger);
+
+	if(logger->async == NULL) {
+		RETURN(fflush(logger->stream) == 0 ? LOGGER_ERR_OK : LOGGER_ERR_STDIO);
+	}
+
+	size_t const target = atomic_load(&logger->async->head);
+	while(atomic_load_explicit(&logger->async->nconsumed, memory_order_acquire) < target) {
+		sched_yield();
+	}
+
+	RETURN(ferror(logger->stream) == 0 ? LOGGER_ERR_OK : LOGGER_ERR_STDIO);
+}
+
+size_t const logger_get_ndropped(logger_t const* const logger)
+{$_
+	logger_assert(logger);
+
+	if(logger->async == NULL) {
+		RETURN(0);
+	}
+	RETURN(atomic_load(&logger->async->ndropped));
+}
+
+logger_err_t const logger_set_binary(logger_t* const logger)
+{$_
+	logger_assert(logger);
+
+	LOGGER_ON_INPUT_ASSERT(
+		ASSERT(logger->binary == NULL);
+	);
+	LOGGER_ON_INPUT_ERROR(
+		if(logger->binary != NULL) {
+			RETURN(LOGGER_ERR_INVALID_ARGUMENT);
+		}
+	);
+
+	struct logger_binary_s* binary = (struct logger_binary_s*)calloc(1, 
+		sizeof(struct logger_binary_s));
+	if(binary == NULL) {
+		RETURN(LOGGER_ERR_MEMORY);
+	}
+
+	if(logger->async != NULL) {
+		logger__async_push(logger->async, LOGGER__BIN_MAGIC, sizeof(LOGGER__BIN_MAGIC) - 1);
+	}
+	else {
+		fwrite(LOGGER__BIN_MAGIC, sizeof(char), sizeof(LOGGER__BIN_MAGIC) - 1, 
+			   logger->stream);
+	}
+
+	logger->binary = binary;
+	RETURN(LOGGER_ERR_OK);
+}
+
+typedef struct {
+	uint64_t id;
+	char const* text;
+	uint32_t len;
+} logger__format_t;
+
+static int logger__format_cmp(void const* vf1, void const* vf2)
+{
+	uint64_t const id1 = ((logger__format_t const*)vf1)->id;
+	uint64_t const id2 = ((logger__format_t const*)vf2)->id;
+	return id1 < id2 ? -1 : id1 > id2;
+}
+
+typedef struct {
+	char const* pos;
+	char const* end;
+	int error;
+} logger__reader_t;
+
+static void logger__get(logger__reader_t* const reader, void* const dst, size_t const n)
+{
+	if(reader->error || (size_t)(reader->end - reader->pos) < n) {
+		reader->error = 1;
+		memset(dst, 0, n);
+		return;
+	}
+	memcpy(dst, reader->pos, n);
+	reader->pos += n;
+}
+
+static uint64_t const logger__get_u64(logger__reader_t* const reader)
+{
+	uint64_t value = 0;
+	logger__get(reader, &value, sizeof(value));
+	return value;
+}
+
+static uint32_t const logger__get_u32(logger__reader_t* const reader)
+{
+	uint32_t value = 0;
+	logger__get(reader, &value, sizeof(value));
+	return value;
+}
+
+// skips an item, returns its tag or '\0' at the end of data
+static char const logger__skip_item(logger__reader_t* const reader)
+{
+	if(reader->pos == reader->end) {
+		return '\0';
+	}
+
+	char tag = '\0';
+	logger__get(reader, &tag, 1);
+	if(reader->error) {
+		return '\0';
+	}
+
+	switch(tag) {
+	case 'M':
+		reader->pos += sizeof(LOGGER__BIN_MAGIC) - 2;
+		break;
+	case LOGGER__BIN_FORMAT:
+		logger__get_u64(reader);
+		reader->pos += logger__get_u32(reader);
+		break;
+	case LOGGER__BIN_START:
+		reader->pos += 1 + 2 * sizeof(uint64_t);
+		break;
+	case LOGGER__BIN_DROPPED:
+		reader->pos += sizeof(uint64_t);
+		break;
+	case LOGGER__BIN_PRINTF:
+		logger__get_u64(reader);
+		reader->pos += logger__get_u32(reader);
+		break;
+	case LOGGER__BIN_TRUNCATED:
+	case LOGGER__BIN_STOP:
+		break;
+	default:
+		reader->error = 1;
+		return '\0';
+	}
+
+	if(reader->pos > reader->end) {
+		reader->error = 1;
+		return '\0';
+	}
+	return tag;
+}
+
+// prints one conversion specification with the length modifier replaced
+static void logger__decode_spec(FILE* const out, logger__spec_t const* const spec,
+								logger__reader_t* const args)
+{
+	char fmt[64];
+	size_t len = 0;
+
+	// flags and width, '*' is replaced by the stored value
+	for(char const* ch = spec->begin; ch < spec->precision && len < 32; ++ch) {
+		if(*ch == '*') {
+			len += (size_t)snprintf(fmt + len, sizeof(fmt) - len, "%lli", 
+									(long long)logger__get_u64(args));
+		}
+		else {
+			fmt[len++] = *ch;
+		}
+	}
+
+	long long precision = -1;
+	if(spec->precision_arg) {
+		precision = (long long)logger__get_u64(args);
+	}
+	else if(spec->precision_value >= 0) {
+		precision = spec->precision_value;
+	}
+
+	char const conv = *(spec->end - 1);
+	switch(spec->arg) {
+	case LOGGER__ARG_STRING: {
+		uint32_t const n = logger__get_u32(args);
+		if(args->error || (size_t)(args->end - args->pos) < n) {
+			args->error = 1;
+			return;
+		}
+		len += (size_t)snprintf(fmt + len, sizeof(fmt) - len, ".*s");
+		fprintf(out, fmt, (int)n, args->pos);
+		args->pos += n;
+		return;
+	}
+	case LOGGER__ARG_ERRNO: {
+		char const* const str = strerror((int)(int64_t)logger__get_u64(args));
+		if(precision >= 0) {
+			len += (size_t)snprintf(fmt + len, sizeof(fmt) - len, ".%lli", precision);
+		}
+		snprintf(fmt + len, sizeof(fmt) - len, "s");
+		fprintf(out, fmt, str);
+		return;
+	}
+	default:
+		break;
+	}
+
+	if(precision >= 0) {
+		len += (size_t)snprintf(fmt + len, sizeof(fmt) - len, ".%lli", precision);
+	}
+
+	switch(spec->arg) {
+	case LOGGER__ARG_INT:
+		snprintf(fmt + len, sizeof(fmt) - len, conv == 'c' ? "c" : "ll%c", conv);
+		if(conv == 'c') {
+			fprintf(out, fmt, (int)logger__get_u64(args));
+		}
+		else {
+			fprintf(out, fmt, (long long)logger__get_u64(args));
+		}
+		break;
+	case LOGGER__ARG_UINT:
+		if(conv == 'c') {
+			snprintf(fmt + len, sizeof(fmt) - len, "lc");
+			fprintf(out, fmt, (wint_t)logger__get_u64(args));
+		}
+		else {
+			snprintf(fmt + len, sizeof(fmt) - len, "ll%c", conv);
+			fprintf(out, fmt, (unsigned long long)logger__get_u64(args));
+		}
+		break;
+	case LOGGER__ARG_DOUBLE: {
+		double value = 0;
+		logger__get(args, &value, sizeof(value));
+		snprintf(fmt + len, sizeof(fmt) - len, "%c", conv);
+		fprintf(out, fmt, value);
+		break;
+	}
+	case LOGGER__ARG_LDOUBLE: {
+		long double value = 0;
+		logger__get(args, &value, sizeof(value));
+		snprintf(fmt + len, sizeof(fmt) - len, "L%c", conv);
+		fprintf(out, fmt, value);
+		break;
+	}
+	case LOGGER__ARG_POINTER:
+		snprintf(fmt + len, sizeof(fmt) - len, "p");
+		fprintf(out, fmt, (void*)(uintptr_t)logger__get_u64(args));
+		break;
+	default:
+		break;
+	}
+}
+
+static void logger__decode_printf(FILE* const out, logger__format_t const* const format,
+								  logger__reader_t* const args)
+{
+	// the text is not '\0' terminated in the log, so it is copied
+	char* const ztext = (char*)calloc(format->len + 1, sizeof(char));
+	if(ztext == NULL) {
+		args->error = 1;
+		return;
+	}
+	memcpy(ztext, format->text, format->len);
+
+	logger__spec_t spec;
+
+	char const* zrover = ztext;
+	for(char const* zspec = logger__next_spec(ztext, &spec); zspec != NULL; 
+		zspec = logger__next_spec(spec.end, &spec)) 
+	{
+		// literal text before the specification, "%%" -> "%"
+		for(; zrover < zspec; ++zrover) {
+			fputc(*zrover, out);
+			if(zrover[0] == '%' && zrover[1] == '%') {
+				++zrover;
+			}
+		}
+		logger__decode_spec(out, &spec, args);
+		zrover = spec.end;
+	}
+	for(; *zrover != '\0'; ++zrover) {
+		fputc(*zrover, out);
+		if(zrover[0] == '%' && zrover[1] == '%') {
+			++zrover;
+		}
+	}
+
+	free(ztext);
+}
+
+logger_err_t const logger_decode(FILE* const in, FILE* const out)
+{$_
+	stream_assert(in);
+	stream_assert(out);
+
+	size_t size = 0;
+	RT_err_t rt_err = RT_OK;
+	char* const data = read_text(in, &size, &rt_err);
+	if(data == NULL) {
+		RETURN(rt_err == RT_MEMORY ? LOGGER_ERR_MEMORY : LOGGER_ERR_STDIO);
+	}
+
+	if(size < sizeof(LOGGER__BIN_MAGIC) - 1 || 
+	   memcmp(data, LOGGER__BIN_MAGIC, sizeof(LOGGER__BIN_MAGIC) - 1) != 0) {
+		free(data);
+		RETURN(LOGGER_ERR_FORMAT);
+	}
+
+	// the first pass collects format definitions
+	size_t nformats = 0;
+	logger__reader_t reader = { data, data + size, 0 };
+	for(char tag = logger__skip_item(&reader); tag != '\0'; tag = logger__skip_item(&reader)) {
+		nformats += tag == LOGGER__BIN_FORMAT;
+	}
+	if(reader.error) {
+		free(data);
+		RETURN(LOGGER_ERR_FORMAT);
+	}
+
+	logger__format_t* formats = (logger__format_t*)calloc(nformats + 1, 
+														  sizeof(logger__format_t));
+	if(formats == NULL) {
+		free(data);
+		RETURN(LOGGER_ERR_MEMORY);
+	}
+
+	size_t iformat = 0;
+	reader = (logger__reader_t){ data, data + size, 0 };
+	for(char const* item = reader.pos; logger__skip_item(&reader) != '\0'; item = reader.pos) {
+		if(*item == LOGGER__BIN_FORMAT) {
+			logger__reader_t def = { item + 1, reader.pos, 0 };
+			formats[iformat].id = logger__get_u64(&def);
+			formats[iformat].len = logger__get_u32(&def);
+			formats[iformat].text = def.pos;
+			++iformat;
+		}
+	}
+	qsort(formats, nformats, sizeof(logger__format_t), logger__format_cmp);
+
+	// the second pass formats records
+	reader = (logger__reader_t){ data, data + size, 0 };
+	for(char const* item = reader.pos; logger__skip_item(&reader) != '\0'; item = reader.pos) {
+		logger__reader_t body = { item + 1, reader.pos, 0 };
+
+		switch(*item) {
+		case LOGGER__BIN_START: {
+			char level = 0;
+			logger__get(&body, &level, 1);
+			uint64_t const time = logger__get_u64(&body);
+			long const tid = (long)(int64_t)logger__get_u64(&body);
+
+			char header[LOGGER_RECORD_SIZE];
+			fwrite(header, sizeof(char), logger__header(header, 
+				(logger_level_t)(unsigned char)level, time, tid), out);
+			break;
+		}
+		case LOGGER__BIN_DROPPED:
+			fprintf(out, "[%llu log records dropped]\n", 
+					(unsigned long long)logger__get_u64(&body));
+			break;
+		case LOGGER__BIN_PRINTF: {
+			logger__format_t key = { logger__get_u64(&body), NULL, 0 };
+			body.pos += sizeof(uint32_t);
+
+			logger__format_t const* format = (logger__format_t const*)bsearch(&key, 
+				formats, nformats, sizeof(logger__format_t), logger__format_cmp);
+			if(format == NULL) {
+				fprintf(out, "[unknown format %#llx]", (unsigned long long)key.id);
+			}
+			else {
+				logger__decode_printf(out, format, &body);
+			}
+			break;
+		}
+		case LOGGER__BIN_TRUNCATED:
+			fputs("...", out);
+			break;
+		case LOGGER__BIN_STOP:
+			fputs(LOGGER_NO_COLOR, out);
+			break;
+		default:
+			break;
+		}
+	}
+
+	free(formats);
+	free(data);
+	RETURN(ferror(out) == 0 ? LOGGER_ERR_OK : LOGGER_ERR_STDIO);
+}
+
 logger_err_t const logger_free(logger_t* const logger)
 {$_
 	logger_assert(logger);
 
+	if(logger->async != NULL) {
+		atomic_store(&logger->async->stop, 1);
+		pthread_join(logger->async->thread, NULL);
+
+		free(logger->async->slots);
+		free(logger->async);
+		logger->async = NULL;
+	}
+
+	free(logger->binary);
+	logger->binary = NULL;
+
 	if(logger->fclose_flag) {
 		fclose(logger->stream);
 	}
@@ -176,27 +1281,43 @@ logger_err_t const logger_start(logger_t* const logger, logger_level_t const lev
 {$_
 	logger_assert(logger);
 
+	logger__record_t* const record = logger->async != NULL ? logger__record(logger) : NULL;
+	int* const ignore_flag = record != NULL ? &record->ignore_flag : &logger->ignore_flag;
+
 	LOGGER_ON_INPUT_ASSERT(
 		ASSERT(logger__validate_level(level));
-		ASSERT(logger->ignore_flag == LOGGER__NO_LOG);
+		ASSERT(*ignore_flag == LOGGER__NO_LOG);
 	);
 	LOGGER_ON_INPUT_ERROR(
 		if(!logger__validate_level(level)) {
 			RETURN(LOGGER_ERR_INVALID_LEVEL);
 		}
-		if(logger->ignore_flag != LOGGER__NO_LOG) {
+		if(*ignore_flag != LOGGER__NO_LOG) {
 			RETURN(LOGGER_ERR_LOG_NOT_FINISHED);
 		}
 	);
 
+	if(record == &logger__no_record) {
+		RETURN(LOGGER_ERR_RECORDS);
+	}
+	if(record != NULL) {
+		record->logger = logger;
+	}
+
 	if(level < logger->min_level) {
-		logger->ignore_flag = LOGGER__LOG_IGNORED;
+		*ignore_flag = LOGGER__LOG_IGNORED;
 		RETURN(LOGGER_ERR_OK);
 	}
 
-	logger->ignore_flag = LOGGER__LOG_STARTED;
-	fprintf(logger->stream, "%s[%s][%s]\n", logger__colorstr(level),
-			"", logger_levelstr(level));
+	*ignore_flag = LOGGER__LOG_STARTED;
+	if(record != NULL) {
+		record->size = logger__rec_start(logger, record->data, level);
+		record->pending.n = 0;
+	}
+	else {
+		char data[LOGGER_RECORD_SIZE];
+		fwrite(data, sizeof(char), logger__rec_start(logger, data, level), logger->stream);
+	}
 
 	RETURN(LOGGER_ERR_OK);
 }
@@ -204,18 +1325,37 @@ logger_err_t const logger_stop(logger_t* const logger)
 {$_
 	logger_assert(logger);
 
+	logger__record_t* const record = logger->async != NULL ? logger__record(logger) : NULL;
+	int* const ignore_flag = record != NULL ? &record->ignore_flag : &logger->ignore_flag;
+
 	LOGGER_ON_INPUT_ASSERT(
-		ASSERT(logger->ignflag != LOGGER__NO_LOG)
+		ASSERT(*ignore_flag != LOGGER__NO_LOG);
 	);
 	LOGGER_ON_INPUT_ERROR(
-		if(logger->ignflag == LOGGER__NO_LOG) {
+		if(*ignore_flag == LOGGER__NO_LOG) {
 			RETURN(LOGGER_ERR_LOG_NOT_STARTED);
 		}
 	);
 
-	logger->ignore_flag = LOGGER__NO_LOG;
+	int const started = *ignore_flag == LOGGER__LOG_STARTED;
+	*ignore_flag = LOGGER__NO_LOG;
+
+	if(!started) {
+		RETURN(LOGGER_ERR_OK);
+	}
 
-	fprintf(logger->stream, LOGGER_NO_COLOR);
+	if(record != NULL) {
+		record->size = logger__rec_stop(logger, record->data, record->size);
+		if(logger__async_push(logger->async, record->data, record->size)) {
+			logger__binary_commit(logger, &record->pending);
+		}
+	}
+	else if(logger->binary != NULL) {
+		fputc(LOGGER__BIN_STOP, logger->stream);
+	}
+	else {
+		fprintf(logger->stream, LOGGER_NO_COLOR);
+	}
 
 	RETURN(LOGGER_ERR_OK);
 }
@@ -223,30 +1363,144 @@ logger_err_t const logger_printf(logger_t* const logger, char const* const forma
 {$_
 	logger_assert(logger);
 
+	logger__record_t* const record = logger->async != NULL ? logger__record(logger) : NULL;
+	int* const ignore_flag = record != NULL ? &record->ignore_flag : &logger->ignore_flag;
+
 	LOGGER_ON_INPUT_ASSERT(
 		ASSERT(format != NULL);
-		ASSERT(logger->ignore_flag != LOGGER__NO_LOG);
+		ASSERT(*ignore_flag != LOGGER__NO_LOG);
 	);
 	LOGGER_ON_INPUT_ERROR(
 		if(format == NULL) {
 			RETURN(LOGGER_ERR_INVALID_ARGUMENT);
 		}
-		if(logger->ignore_flag == LOGGER__NO_LOG) {
+		if(*ignore_flag == LOGGER__NO_LOG) {
 			RETURN(LOGGER_ERR_LOG_NOT_STARTED);
 		}
 	);
 
-	if(logger->ignore_flag == LOGGER__LOG_IGNORED)
+	if(*ignore_flag == LOGGER__LOG_IGNORED)
 		RETURN(LOGGER_ERR_OK);
 
 	va_list l;
 	va_start(l, format);
-	vfprintf(logger->stream, format, l);
+	if(record != NULL) {
+		record->size = logger__rec_vprintf(logger, record->data, record->size, format, l,
+										   &record->pending);
+	}
+	else if(logger->binary != NULL) {
+		char data[LOGGER_RECORD_SIZE];
+		logger__pending_t pending = {};
+		size_t const size = logger__rec_vprintf(logger, data, 0, format, l, &pending);
+		if(fwrite(data, sizeof(char), size, logger->stream) == size) {
+			logger__binary_commit(logger, &pending);
+		}
+	}
+	else {
+		vfprintf(logger->stream, format, l);
+	}
 	va_end(l);
 
 	RETURN(LOGGER_ERR_OK);
 }
 
+logger_err_t const logger_printf0(logger_t* const logger, logger_level_t const level,
+								  char const* const format, ...)
+{$_
+	logger_assert(logger);
+
+	LOGGER_ON_INPUT_ASSERT(
+		ASSERT(logger__validate_level(level));
+		ASSERT(format != NULL);
+	);
+	LOGGER_ON_INPUT_ERROR(
+		if(!logger__validate_level(level)) {
+			RETURN(LOGGER_ERR_INVALID_LEVEL);
+		}
+		if(format == NULL) {
+			RETURN(LOGGER_ERR_INVALID_ARGUMENT);
+		}
+	);
+
+	if(level < logger->min_level) {
+		RETURN(LOGGER_ERR_OK);
+	}
+
+	va_list l;
+	va_start(l, format);
+	if(logger->async != NULL || logger->binary != NULL) {
+		char data[LOGGER_RECORD_SIZE];
+		logger__pending_t pending = {};
+		size_t size = logger__rec_start(logger, data, level);
+		size = logger__rec_vprintf(logger, data, size, format, l, &pending);
+		size = logger__rec_stop(logger, data, size);
+
+		int const written = logger->async != NULL ? 
+							logger__async_push(logger->async, data, size) :
+							fwrite(data, sizeof(char), size, logger->stream) == size;
+		if(written) {
+			logger__binary_commit(logger, &pending);
+		}
+	}
+	else {
+		// the whole record at once, so records from different threads don't mix
+		char header[LOGGER_RECORD_SIZE];
+		size_t const header_size = logger__rec_start(logger, header, level);
+
+		flockfile(logger->stream);
+		fwrite(header, sizeof(char), header_size, logger->stream);
+		vfprintf(logger->stream, format, l);
+		fprintf(logger->stream, LOGGER_NO_COLOR);
+		funlockfile(logger->stream);
+	}
+	va_end(l);
+
+	RETURN(LOGGER_ERR_OK);
+}
+
+int const logger_ratelimit(logger_t* const logger, logger_level_t const level,
+						   logger_ratelimit_t* const ratelimit, double const rate,
+						   size_t const burst)
+{$_
+	ASSERT(ratelimit != NULL);
+
+	uint64_t const now = logger__clock(CLOCK_MONOTONIC_COARSE);
+
+	while(atomic_flag_test_and_set_explicit(&ratelimit->lock, memory_order_acquire)) {
+		sched_yield();
+	}
+
+	if(ratelimit->last == 0) {
+		ratelimit->tokens = (double)burst;
+	}
+	else {
+		ratelimit->tokens += (double)(now - ratelimit->last) * 1e-9 * rate;
+		if(ratelimit->tokens > (double)burst) {
+			ratelimit->tokens = (double)burst;
+		}
+	}
+	ratelimit->last = now;
+
+	int allowed = 0;
+	size_t nsuppressed = 0;
+	if(ratelimit->tokens >= 1.0) {
+		ratelimit->tokens -= 1.0;
+		nsuppressed = ratelimit->nsuppressed;
+		ratelimit->nsuppressed = 0;
+		allowed = 1;
+	}
+	else {
+		++ratelimit->nsuppressed;
+	}
+
+	atomic_flag_clear_explicit(&ratelimit->lock, memory_order_release);
+
+	if(nsuppressed != 0) {
+		logger_printf0(logger, level, "%zu messages suppressed\n", nsuppressed);
+	}
+	RETURN(allowed);
+}
+
 logger_err_t const logger_valid(logger_t const* const logger)
 {$_
 	if(logger == NULL) {
@@ -284,6 +1538,16 @@ void logger__dump(logger_t const* const logger, FILE* const stream,
 		fprintf(stream, "\tfclose_flag = %i\n", logger->fclose_flag);
 		fprintf(stream, "\tignore_flag = %i (%s)\n", logger->ignore_flag,
 				logger__ignflagstr(logger->ignore_flag));
+		fprintf(stream, "\tbinary [%p]\n", logger->binary);
+		fprintf(stream, "\tasync [%p]\n", logger->async);
+		if(logger->async != NULL) {
+			fprintf(stream, "\t\tcapacity = %zu\n", logger->async->mask + 1);
+			fprintf(stream, "\t\toverflow = %i\n", logger->async->overflow);
+			fprintf(stream, "\t\thead = %zu\n", atomic_load(&logger->async->head));
+			fprintf(stream, "\t\tnconsumed = %zu\n", 
+					atomic_load(&logger->async->nconsumed));
+			fprintf(stream, "\t\tndropped = %zu\n", atomic_load(&logger->async->ndropped));
+		}
 	}
 
 	fprintf(stream, "}\n");
@@ -52,11 +52,74 @@
 #	define LOGGER_DEBUG_TITLE "DEBUG"
 #endif
 
+/** \def LOGGER_RECORD_SIZE
+ * \brief Максимальный размер одной записи асинхронного логгера в байтах.
+ *
+ * Более длинные записи обрезаются. Может быть переопределено при компиляции библиотеки.
+ */
+#ifndef LOGGER_RECORD_SIZE
+#	define LOGGER_RECORD_SIZE 512
+#endif
+
+/** \def LOGGER_ASYNC_BATCH_SIZE
+ * \brief Размер буфера, которым фоновый поток асинхронного логгера пишет в поток.
+ *
+ * Может быть переопределено при компиляции библиотеки.
+ */
+#ifndef LOGGER_ASYNC_BATCH_SIZE
+#	define LOGGER_ASYNC_BATCH_SIZE (64 * 1024)
+#endif
+
+/** \def LOGGER_ASYNC_SLEEP_US
+ * \brief Время сна фонового потока асинхронного логгера при пустой очереди в
+ * 		микросекундах.
+ *
+ * Может быть переопределено при компиляции библиотеки.
+ */
+#ifndef LOGGER_ASYNC_SLEEP_US
+#	define LOGGER_ASYNC_SLEEP_US 1000
+#endif
+
+/** \def LOGGER_ASYNC_NRECORDS
+ * \brief Количество асинхронных логгеров, в которых один поток может одновременно
+ * 		начать запись (logger_start - logger_stop).
+ *
+ * Может быть переопределено при компиляции библиотеки.
+ */
+#ifndef LOGGER_ASYNC_NRECORDS
+#	define LOGGER_ASYNC_NRECORDS 4
+#endif
+
+/** \def LOGGER_BINARY_NFORMATS
+ * \brief Размер таблицы уже записанных форматных строк бинарного логгера.
+ *
+ * Должно быть степенью двойки. Если таблица заполнена, форматные строки
+ * записываются повторно. Может быть переопределено при компиляции библиотеки.
+ */
+#ifndef LOGGER_BINARY_NFORMATS
+#	define LOGGER_BINARY_NFORMATS 1024
+#endif
+
+/** \def LOGGER_COMPILE_MIN_LEVEL
+ * \brief Минимальный уровень записей, которые остаются в программе при использовании
+ * макросов LOGGER_LOG*.
+ *
+ * Записи с меньшим уровнем удаляются компилятором вместе с вычислением аргументов,
+ * но продолжают проверяться на корректность. Определяется при компиляции программы,
+ * например -DLOGGER_COMPILE_MIN_LEVEL=LOGGER_INFO.
+ */
+#ifndef LOGGER_COMPILE_MIN_LEVEL
+#	define LOGGER_COMPILE_MIN_LEVEL LOGGER_DEBUG
+#endif
+
 #define LOGGER__NO_LOG 0
 #define LOGGER__LOG_STARTED 1
 #define LOGGER__LOG_IGNORED 2
 
 #include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
 
 typedef enum {
 	LOGGER_DEBUG 		= 0,
@@ -67,6 +130,15 @@ typedef enum {
 	LOGGER_NLEVELS
 } logger_level_t;
 
+/// Поведение асинхронного логгера при переполнении очереди записей.
+typedef enum {
+	LOGGER_OVERFLOW_BLOCK = 0, ///< Ждать, пока фоновый поток освободит место.
+	LOGGER_OVERFLOW_DROP  = 1, ///< Молча отбросить запись.
+	LOGGER_OVERFLOW_COUNT = 2, ///< Отбросить запись и сообщить их количество в логе.
+
+	LOGGER_NOVERFLOWS
+} logger_overflow_t;
+
 typedef enum {
 	LOGGER_ERR_OK = 0,
 	LOGGER_ERR_STDIO,
@@ -78,6 +150,10 @@ typedef enum {
 	LOGGER_ERR_NULL,
 	LOGGER_ERR_REINIT_PROBABILITY,
 	LOGGER_ERR_INVALID_IGNORE_FLAG,
+	LOGGER_ERR_MEMORY,
+	LOGGER_ERR_THREAD,
+	LOGGER_ERR_FORMAT,
+	LOGGER_ERR_RECORDS,
 
 	LOGGER_NERRORS
 } logger_err_t;
@@ -94,6 +170,11 @@ typedef struct logger__s {
 
 	int fclose_flag;
 	int ignore_flag;
+
+	// NULL for the synchronous logger
+	struct logger_async_s* async;
+	// NULL for the text logger
+	struct logger_binary_s* binary;
 } logger_t;
 
 char const* const logger_levelstr(logger_level_t const level);
@@ -103,6 +184,59 @@ logger_err_t const logger_init(logger_t* const logger, FILE* const stream,
 							   logger_level_t const min_level, int fclose_flag);
 logger_err_t const logger_free(logger_t* const logger);
 
+/**
+ * \brief Инициализирует асинхронный логгер.
+ *
+ * Записи складываются в ограниченную очередь без блокировок, а фоновый поток
+ * пишет их в stream большими блоками. Начатая в потоке запись (logger_start -
+ * logger_stop) хранится в памяти этого потока отдельно для каждого логгера, поэтому
+ * логгер можно использовать из нескольких потоков одновременно, а поток может вести
+ * записи в нескольких логгерах (не более LOGGER_ASYNC_NRECORDS, иначе logger_start()
+ * возвращает LOGGER_ERR_RECORDS). logger_free() дописывает все записи из очереди.
+ *
+ * \param[in] capacity количество записей в очереди, округляется вверх до степени двойки.
+ * \param[in] overflow поведение при переполнении очереди.
+ */
+logger_err_t const logger_init_async(logger_t* const logger, FILE* const stream,
+									 logger_level_t const min_level, int fclose_flag,
+									 size_t const capacity, 
+									 logger_overflow_t const overflow);
+
+/**
+ * \brief Дожидается записи в поток всех сообщений, завершенных к моменту вызова.
+ */
+logger_err_t const logger_flush(logger_t* const logger);
+
+/**
+ * \brief Возвращает количество записей, отброшенных асинхронным логгером из-за
+ * 		переполнения очереди.
+ */
+size_t const logger_get_ndropped(logger_t const* const logger);
+
+/**
+ * \brief Переводит логгер в бинарный режим с отложенным форматированием.
+ *
+ * Вместо форматирования каждый вызов logger_printf сохраняет указатель на
+ * форматную строку и значения аргументов (строки копируются), а текст
+ * формирует logger_decode() или утилита LogDecode. Уровни и заголовки записей
+ * сохраняются. Работает как с синхронным, так и с асинхронным логгером.
+ * Должна вызываться сразу после инициализации, до первой записи.
+ *
+ * %m сохраняет значение errno на момент вызова.
+ *
+ * \warning Форматные строки должны жить до конца работы логгера. %n игнорируется:
+ * 		по переданному указателю ничего не записывается.
+ */
+logger_err_t const logger_set_binary(logger_t* const logger);
+
+/**
+ * \brief Преобразует бинарный лог, записанный в режиме logger_set_binary, в текст.
+ *
+ * \param[in] in бинарный лог. Поток должен поддерживать fseek.
+ * \param[in] out поток для текста.
+ */
+logger_err_t const logger_decode(FILE* const in, FILE* const out);
+
 logger_err_t const logger_min_level(logger_t* const logger, logger_level_t level);
 logger_level_t const logger_get_min_level(logger_t const* const logger);
 char const* const logger_get_min_level_str(logger_t const* const logger);
@@ -115,6 +249,81 @@ int const logger_get_ignore_flag(logger_t const* const logger);
 logger_err_t const logger_printf0(logger_t* const logger, logger_level_t const level,
 								  char const* const format, ...);
 
+/**
+ * \brief Проверяет, будет ли записана запись уровня level.
+ *
+ * Не проверяет корректность логгера и не вызывает функций, поэтому годится
+ * для проверки перед дорогим вычислением аргументов.
+ */
+static inline int const logger_enabled(logger_t const* const logger, 
+									   logger_level_t const level)
+{
+	return level >= LOGGER_COMPILE_MIN_LEVEL && level >= logger->min_level;
+}
+
+/** \def LOGGER_LOG(logger, level, ...)
+ * \brief Записывает запись как logger_printf0, но аргументы вычисляются, только если
+ * запись будет записана.
+ *
+ * Записи уровня ниже LOGGER_COMPILE_MIN_LEVEL не попадают в программу.
+ */
+#define LOGGER_LOG(logger, level, ...) 								\
+	do {															\
+		if((level) >= LOGGER_COMPILE_MIN_LEVEL && 					\
+		   logger_enabled((logger), (level))) {						\
+			logger_printf0((logger), (level), __VA_ARGS__);			\
+		}															\
+	} while(0)
+
+#define LOGGER_LOG_DEBUG(logger, ...) 	LOGGER_LOG(logger, LOGGER_DEBUG, __VA_ARGS__)
+#define LOGGER_LOG_INFO(logger, ...) 	LOGGER_LOG(logger, LOGGER_INFO, __VA_ARGS__)
+#define LOGGER_LOG_WARNING(logger, ...) LOGGER_LOG(logger, LOGGER_WARNING, __VA_ARGS__)
+#define LOGGER_LOG_ERROR(logger, ...) 	LOGGER_LOG(logger, LOGGER_ERROR, __VA_ARGS__)
+
+/**
+ * \brief Состояние ограничителя частоты записей одного места вызова (token bucket).
+ *
+ * Инициализируется LOGGER_RATELIMIT_INITIALIZER, обычно объявляется static
+ * макросом LOGGER_LOG_RATELIMITED.
+ */
+typedef struct {
+	atomic_flag lock;
+	double tokens;
+	uint64_t last;		///< время последнего пополнения, нс (0 - еще не использовался)
+	size_t nsuppressed;	///< количество отброшенных с последней записи сообщений
+} logger_ratelimit_t;
+
+#define LOGGER_RATELIMIT_INITIALIZER { ATOMIC_FLAG_INIT, 0.0, 0, 0 }
+
+/**
+ * \brief Решает, можно ли записать очередное сообщение места вызова ratelimit.
+ *
+ * Разрешает в среднем rate сообщений в секунду и не более burst подряд. Если перед
+ * разрешенным сообщением были отброшенные, сначала записывает запись уровня level
+ * "N messages suppressed".
+ *
+ * \return 1, если сообщение нужно записать, иначе 0.
+ */
+int const logger_ratelimit(logger_t* const logger, logger_level_t const level,
+						   logger_ratelimit_t* const ratelimit, double const rate,
+						   size_t const burst);
+
+/** \def LOGGER_LOG_RATELIMITED(logger, level, rate, burst, ...)
+ * \brief LOGGER_LOG, который записывает не более rate сообщений в секунду
+ * (и не более burst подряд) из данного места вызова.
+ */
+#define LOGGER_LOG_RATELIMITED(logger, level, rate, burst, ...)				\
+	do {																	\
+		static logger_ratelimit_t logger__ratelimit = 						\
+			LOGGER_RATELIMIT_INITIALIZER;									\
+		if((level) >= LOGGER_COMPILE_MIN_LEVEL && 							\
+		   logger_enabled((logger), (level)) &&								\
+		   logger_ratelimit((logger), (level), &logger__ratelimit, 			\
+							(rate), (burst))) {								\
+			logger_printf0((logger), (level), __VA_ARGS__);					\
+		}																	\
+	} while(0)
+
 logger_err_t const logger_valid(logger_t const* const logger);
 void logger__dump(logger_t const* const logger, FILE* const stream,
 				  char const* const funcname, char const* const filename, 
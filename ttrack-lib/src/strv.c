@@ -2,8 +2,15 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include <stddef.h>
+#include <pthread.h>
 #include "dbg.h"
 #include "strv.h"
+#include "text.h"
+
+#if defined __x86_64__ || defined __i386__
+#	include <immintrin.h>
+#	define STRV__X86
+#endif
 
 char const* strv_errstr(strv_err_t err)
 {$_
@@ -178,38 +185,176 @@ int const strv_ccmp(strv_t const* strv, char const* cstr)
 $$
 }
 
-strv_t const strv_ntok(strv_t* strv, char const* delimers)
+void strv_cset_init(strv_cset_t* cset, char const* chars)
+{$_
+	ASSERT(cset != NULL);
+	ASSERT(chars != NULL);
+
+	memset(cset, 0, sizeof(strv_cset_t));
+	for(; *chars != '\0'; ++chars) {
+		unsigned char const c = (unsigned char)*chars;
+		cset->bits[c >> 6] |= (uint64_t)1 << (c & 63);
+		cset->rows[c >> 7][c & 15] |= (unsigned char)(1 << ((c >> 4) & 7));
+	}
+$$
+}
+
+int const strv_cset_has(strv_cset_t const* cset, char c)
+{$_
+	ASSERT(cset != NULL);
+
+	unsigned char const uc = (unsigned char)c;
+	RETURN((cset->bits[uc >> 6] >> (uc & 63)) & 1);
+$$
+}
+
+static inline int const strv__has(strv_cset_t const* cset, unsigned char c)
+{
+	return (cset->bits[c >> 6] >> (c & 63)) & 1;
+}
+
+static char const* strv__scan_scalar(char const* ch, char const* last, 
+									 strv_cset_t const* cset, int const want)
+{
+	for(; ch < last; ++ch) {
+		if(strv__has(cset, (unsigned char)*ch) == want) {
+			return ch;
+		}
+	}
+	return NULL;
+}
+
+#ifdef STRV__X86
+
+__attribute__((target("ssse3")))
+static char const* strv__scan_ssse3(char const* ch, char const* last, 
+									strv_cset_t const* cset, int const want)
+{
+	__m128i const row_lo = _mm_loadu_si128((__m128i const*)cset->rows[0]);
+	__m128i const row_hi = _mm_loadu_si128((__m128i const*)cset->rows[1]);
+	__m128i const bit = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 
+									  1, 2, 4, 8, 16, 32, 64, -128);
+	__m128i const nibble = _mm_set1_epi8(0x0F);
+	__m128i const index = _mm_set1_epi8((char)0x8F);
+	__m128i const high = _mm_set1_epi8((char)0x80);
+	__m128i const zero = _mm_setzero_si128();
+
+	for(; ch + 16 <= last; ch += 16) {
+		__m128i const block = _mm_loadu_si128((__m128i const*)ch);
+
+		// shuffle gives 0 for indices with the high bit set, so each row answers
+		// only for its half of the characters
+		__m128i const idx = _mm_and_si128(block, index);
+		__m128i const row = _mm_or_si128(_mm_shuffle_epi8(row_lo, idx),
+			_mm_shuffle_epi8(row_hi, _mm_xor_si128(idx, high)));
+		__m128i const col = _mm_shuffle_epi8(bit, 
+			_mm_and_si128(_mm_srli_epi16(block, 4), nibble));
+
+		unsigned const outside = (unsigned)_mm_movemask_epi8(
+			_mm_cmpeq_epi8(_mm_and_si128(row, col), zero));
+		unsigned const mask = want ? ~outside & 0xFFFF : outside;
+		if(mask != 0) {
+			return ch + __builtin_ctz(mask);
+		}
+	}
+	return strv__scan_scalar(ch, last, cset, want);
+}
+
+#endif /* STRV__X86 */
+
+typedef char const* (*strv__scan_fn)(char const*, char const*, strv_cset_t const*, int);
+
+static strv__scan_fn strv__scan_impl = NULL;
+
+// the implementation is selected once, before the first use in any thread
+static pthread_once_t strv__scan_once = PTHREAD_ONCE_INIT;
+
+static void strv__select_scan()
+{
+	strv__scan_impl = strv__scan_scalar;
+#ifdef STRV__X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("ssse3")) {
+		strv__scan_impl = strv__scan_ssse3;
+	}
+#endif
+}
+
+static char const* strv__scan(char const* first, char const* last, 
+							  strv_cset_t const* cset, int const want)
+{
+	pthread_once(&strv__scan_once, strv__select_scan);
+	return strv__scan_impl(first, last, cset, want);
+}
+
+char const* strv_find(strv_t const* strv, char c)
+{$_
+	strv_assert(strv);
+
+	// libc memchr is vectorized already
+	RETURN((char const*)memchr(strv->pfirst, c, (size_t)(strv->plast - strv->pfirst)));
+$$
+}
+
+char const* strv_find_any(strv_t const* strv, strv_cset_t const* cset)
+{$_
+	strv_assert(strv);
+	ASSERT(cset != NULL);
+
+	RETURN(strv__scan(strv->pfirst, strv->plast, cset, 1));
+$$
+}
+
+char const* strv_find_not(strv_t const* strv, strv_cset_t const* cset)
+{$_
+	strv_assert(strv);
+	ASSERT(cset != NULL);
+
+	RETURN(strv__scan(strv->pfirst, strv->plast, cset, 0));
+$$
+}
+
+size_t const strv_count(strv_t const* strv, char c)
+{$_
+	strv_assert(strv);
+
+	// count_lines() uses SSE2/AVX2 search of separators
+	RETURN(count_lines(strv->pfirst, (size_t)(strv->plast - strv->pfirst), c) - 1);
+$$
+}
+
+strv_t const strv_ntokc(strv_t* strv, strv_cset_t const* delimers)
 {$_
 	strv_assert(strv);
 	ASSERT(delimers != NULL);
 
-	while(strv->pfirst < strv->plast && strchr(delimers, *strv->pfirst) != NULL) { 
-		++strv->pfirst;
+	char const* first = strv__scan(strv->pfirst, strv->plast, delimers, 0);
+	if(first == NULL) {
+		strv->pfirst = strv->plast;
+		RETURN(*strv);
 	}
 
-	char const* rover = strv->pfirst;
-
-	for(; strv->pfirst < strv->plast; ++strv->pfirst) {
-		if(strchr(delimers, *strv->pfirst) != NULL) {
-			RETURN(strv_init(rover, strv->pfirst));
-		}
+	char const* last = strv__scan(first, strv->plast, delimers, 1);
+	if(last == NULL) {
+		last = strv->plast;
 	}
-	
-	RETURN(*strv);
+
+	strv->pfirst = last;
+	RETURN(strv_init(first, last));
 $$
 }
 
-size_t const strv_tok(strv_t* strv, char const* delimers, strv_t* tokens,
-					  size_t max_count)
+size_t const strv_tokc(strv_t* strv, strv_cset_t const* delimers, strv_t* tokens,
+					   size_t max_count)
 {$_
 	strv_assert(strv);
 	ASSERT(delimers != NULL);
 	ASSERT(tokens != NULL);
 
 	size_t count = 0;
-	for(strv_t cstrv = strv_ntok(strv, delimers); 
+	for(strv_t cstrv = strv_ntokc(strv, delimers); 
 		!strv_empty(&cstrv) && count < max_count;
-		cstrv = strv_ntok(strv, delimers)) 
+		cstrv = strv_ntokc(strv, delimers)) 
 	{
 		*tokens = cstrv;
 		++tokens;
@@ -220,6 +365,29 @@ size_t const strv_tok(strv_t* strv, char const* delimers, strv_t* tokens,
 $$
 }
 
+strv_t const strv_ntok(strv_t* strv, char const* delimers)
+{$_
+	strv_assert(strv);
+	ASSERT(delimers != NULL);
+
+	strv_cset_t cset;
+	strv_cset_init(&cset, delimers);
+	RETURN(strv_ntokc(strv, &cset));
+$$
+}
+
+size_t const strv_tok(strv_t* strv, char const* delimers, strv_t* tokens,
+					  size_t max_count)
+{$_
+	strv_assert(strv);
+	ASSERT(delimers != NULL);
+
+	strv_cset_t cset;
+	strv_cset_init(&cset, delimers);
+	RETURN(strv_tokc(strv, &cset, tokens, max_count));
+$$
+}
+
 strv_err_t const strv_check(strv_t const* strv)
 {$_
 	if(strv == NULL) { RETURN(STRV_ERR_NULL); }
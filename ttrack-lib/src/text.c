@@ -1,9 +1,22 @@
+#define _GNU_SOURCE
+
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <errno.h>
+#include <sys/uio.h>
 #include "dbg.h"
 #include "text.h"
 
+#if defined __x86_64__ || defined __i386__
+#	include <immintrin.h>
+#	define TEXT__X86
+#endif
+
 size_t const fsize(FILE* const file) 
 {$_
 	ASSERT(file != NULL);
@@ -21,17 +34,224 @@ size_t const fsize(FILE* const file)
 	RETURN((size_t)size);
 }
 
+/*
+ * Separator search. The text is scanned by blocks of TEXT__BLOCK bytes: a block
+ * is compared with the separator by SSE2 or AVX2 instructions, the comparison
+ * result is packed into a bit mask (movemask) and the set bits are enumerated.
+ * The implementation is chosen once by CPU features (see text_set_simd()).
+ */
+#define TEXT__BLOCK 32
+
+typedef struct {
+	char const* ch;		// scanning position
+	char const* rover;	// beginning of the current line
+	strv_t* lines;		// beginning of the output
+	strv_t* curline;	// next line to be stored
+	size_t capacity;	// size of the output
+} text__split_t;
+
+typedef size_t const (*text__count_fn)(char const* text, size_t size, char sep);
+typedef void (*text__split_fn)(text__split_t* split, char const* end, char sep);
+
+// adds lines for all separators marked in mask of the block at ch
+static inline void text__emit(text__split_t* const split, char const* const ch, 
+							  uint32_t mask)
+{
+	while(mask != 0) {
+		char const* const pos = ch + __builtin_ctz(mask);
+		mask &= mask - 1;
+
+		split->curline->pfirst = split->rover;
+		split->curline->plast = pos;
+		++split->curline;
+		split->rover = pos + 1;
+	}
+}
+
+// stops before the block, which may not fit into the output
+static inline int const text__has_room(text__split_t const* const split)
+{
+	return (size_t)(split->curline - split->lines) + TEXT__BLOCK <= split->capacity;
+}
+
+static void text__split_tail(text__split_t* const split, char const* const end, 
+							 char const sep)
+{
+	for(; split->ch < end; ++split->ch) {
+		if(*split->ch == sep) {
+			if((size_t)(split->curline - split->lines) == split->capacity) {
+				return;
+			}
+			text__emit(split, split->ch, 1);
+		}
+	}
+}
+
+static size_t const text__count_scalar(char const* const text, size_t const size, 
+									   char const sep)
+{
+	size_t nseps = 0;
+	for(char const* ch = text; ch < text + size; ++ch) {
+		nseps += *ch == sep;
+	}
+	return nseps;
+}
+
+static void text__split_scalar(text__split_t* const split, char const* const end,
+							   char const sep)
+{
+	text__split_tail(split, end, sep);
+}
+
+#ifdef TEXT__X86
+
+static size_t const text__count_sse2(char const* const text, size_t const size, 
+									 char const sep)
+{
+	__m128i const vsep = _mm_set1_epi8(sep);
+	char const* ch = text;
+	size_t nseps = 0;
+
+	for(; ch + 16 <= text + size; ch += 16) {
+		__m128i const block = _mm_loadu_si128((__m128i const*)ch);
+		nseps += (size_t)__builtin_popcount(
+			(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block, vsep)));
+	}
+	return nseps + text__count_scalar(ch, (size_t)(text + size - ch), sep);
+}
+
+static void text__split_sse2(text__split_t* const split, char const* const end,
+							 char const sep)
+{
+	__m128i const vsep = _mm_set1_epi8(sep);
+
+	for(; split->ch + TEXT__BLOCK <= end && text__has_room(split); 
+		split->ch += TEXT__BLOCK) 
+	{
+		__m128i const lo = _mm_loadu_si128((__m128i const*)split->ch);
+		__m128i const hi = _mm_loadu_si128((__m128i const*)(split->ch + 16));
+		uint32_t const mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(lo, vsep)) |
+			(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(hi, vsep)) << 16;
+		text__emit(split, split->ch, mask);
+	}
+	if(split->ch + TEXT__BLOCK > end) {
+		text__split_tail(split, end, sep);
+	}
+}
+
+__attribute__((target("avx2")))
+static size_t const text__count_avx2(char const* const text, size_t const size, 
+									 char const sep)
+{
+	__m256i const vsep = _mm256_set1_epi8(sep);
+	char const* ch = text;
+	size_t nseps = 0;
+
+	for(; ch + 32 <= text + size; ch += 32) {
+		__m256i const block = _mm256_loadu_si256((__m256i const*)ch);
+		nseps += (size_t)__builtin_popcount(
+			(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, vsep)));
+	}
+	return nseps + text__count_scalar(ch, (size_t)(text + size - ch), sep);
+}
+
+__attribute__((target("avx2")))
+static void text__split_avx2(text__split_t* const split, char const* const end,
+							 char const sep)
+{
+	__m256i const vsep = _mm256_set1_epi8(sep);
+
+	for(; split->ch + TEXT__BLOCK <= end && text__has_room(split); 
+		split->ch += TEXT__BLOCK) 
+	{
+		__m256i const block = _mm256_loadu_si256((__m256i const*)split->ch);
+		uint32_t const mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, vsep));
+		text__emit(split, split->ch, mask);
+	}
+	if(split->ch + TEXT__BLOCK > end) {
+		text__split_tail(split, end, sep);
+	}
+}
+
+#endif /* TEXT__X86 */
+
+static text__count_fn text__count = NULL;
+static text__split_fn text__split = NULL;
+
+// the default implementation is selected once, before the first use in any thread
+static pthread_once_t text__simd_once = PTHREAD_ONCE_INIT;
+
+static text_simd_t const text__select_simd(text_simd_t simd)
+{
+	text_simd_t supported = TEXT_SIMD_SCALAR;
+#ifdef TEXT__X86
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2")) {
+		supported = TEXT_SIMD_AVX2;
+	}
+	else if(__builtin_cpu_supports("sse2")) {
+		supported = TEXT_SIMD_SSE2;
+	}
+#endif
+
+	if(simd == TEXT_SIMD_AUTO || simd > supported) {
+		simd = supported;
+	}
+
+	switch(simd) {
+#ifdef TEXT__X86
+	case TEXT_SIMD_AVX2:
+		text__count = text__count_avx2;
+		text__split = text__split_avx2;
+		break;
+	case TEXT_SIMD_SSE2:
+		text__count = text__count_sse2;
+		text__split = text__split_sse2;
+		break;
+#endif
+	default:
+		simd = TEXT_SIMD_SCALAR;
+		text__count = text__count_scalar;
+		text__split = text__split_scalar;
+		break;
+	}
+
+	return simd;
+}
+
+static void text__select_auto()
+{
+	text__select_simd(TEXT_SIMD_AUTO);
+}
+
+static void text__init_simd()
+{
+	pthread_once(&text__simd_once, text__select_auto);
+}
+
+text_simd_t const text_set_simd(text_simd_t simd)
+{$_
+	ASSERT(simd >= TEXT_SIMD_AUTO && simd <= TEXT_SIMD_AVX2);
+
+	// the default must not override the selection later
+	text__init_simd();
+	RETURN(text__select_simd(simd));
+}
+
+// runs the split until the end of the text or until the output is full
+static void text__split_run(text__split_t* const split, char const* const end,
+							char const sep)
+{
+	text__init_simd();
+	text__split(split, end, sep);
+}
+
 size_t const count_lines(char const * const text, size_t const size, char const sep)
 {$_
 	ASSERT(text != NULL);
 
-	size_t nlines = 0;
-	for(char const* ch = text; ch < text + size; ++ch) {
-		if(*ch == sep)
-			++nlines;
-	}
-	
-	RETURN(nlines + 1);
+	text__init_simd();
+	RETURN(text__count(text, size, sep) + 1);
 }
 
 size_t const split_text(char * const text, size_t const size, char const sep, 
@@ -40,23 +260,13 @@ size_t const split_text(char * const text, size_t const size, char const sep,
 	ASSERT(text != NULL);
 	ASSERT(lines != NULL);
 
-	// test: empty text
-
-	strv_t* curline = lines;
+	// the caller has allocated count_lines() lines
+	text__split_t split = { text, text, lines, lines, SIZE_MAX };
+	text__split_run(&split, text + size, sep);
 
-	char * rover = text;
-	for(char * ch = text; ch < text + size; ++ch) {
-		if(*ch == sep) {
-			*curline = strv_init(rover, ch);
-			++curline;
+	*split.curline = strv_init(split.rover, text + size);
 
-			rover = ch + 1;
-		}
-	}
-
-	*curline = strv_init(rover, text + size);
-
-	RETURN(curline - lines + 1);
+	RETURN(split.curline - lines + 1);
 }
 
 char* const read_text(FILE* const file, size_t* const psize, RT_err_t* const errc)
@@ -88,23 +298,245 @@ char* const read_text(FILE* const file, size_t* const psize, RT_err_t* const err
 	RETURN(text);
 }
 
-int const write_lines(FILE* const file, strv_t const * const lines, 
-					   size_t const nlines) 
+static size_t const text__mapping_size(size_t const size)
+{
+	size_t const page = (size_t)sysconf(_SC_PAGESIZE);
+	return (size + 1 + page - 1) / page * page;
+}
+
+/*
+ * Reads a stream of unknown size into anonymous memory, so the result can be
+ * released by unmap_text() as well as a real mapping.
+ */
+static char* const text__read_anonymous(FILE* const file, MT_mode_t const mode,
+										size_t* const psize, RT_err_t* const errc)
+{$_
+	size_t capacity = text__mapping_size(0);
+	char* text = (char*)mmap(NULL, capacity, PROT_READ | PROT_WRITE, 
+							 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(text == MAP_FAILED) {
+		if(errc != NULL) { *errc = RT_MEMORY; }
+		RETURN(NULL);
+	}
+
+	size_t size = 0;
+	for(;;) {
+		size += fread(text + size, sizeof(char), capacity - 1 - size, file);
+		if(size < capacity - 1) {
+			break;
+		}
+
+		char* const new_text = (char*)mremap(text, capacity, 2 * capacity, MREMAP_MAYMOVE);
+		if(new_text == MAP_FAILED) {
+			munmap(text, capacity);
+			if(errc != NULL) { *errc = RT_MEMORY; }
+			RETURN(NULL);
+		}
+		text = new_text;
+		capacity *= 2;
+	}
+
+	if(ferror(file)) {
+		munmap(text, capacity);
+		if(errc != NULL) { *errc = RT_IO; }
+		RETURN(NULL);
+	}
+
+	// unmap_text() knows only the size of the data
+	size_t const mapping_size = text__mapping_size(size);
+	if(mapping_size < capacity) {
+		munmap(text + mapping_size, capacity - mapping_size);
+	}
+	if(mode == MT_READONLY) {
+		mprotect(text, mapping_size, PROT_READ);
+	}
+
+	*psize = size;
+	if(errc != NULL) { *errc = RT_OK; }
+	RETURN(text);
+}
+
+char* const map_text(FILE* const file, MT_mode_t const mode, size_t* const psize, 
+					 RT_err_t* const errc)
 {$_
 	ASSERT(file != NULL);
 	ASSERT(ferror(file) == 0);
-	ASSERT(lines != NULL);
+	ASSERT(psize != NULL);
+
+	int const fd = fileno(file);
+	struct stat st;
+	if(fd == -1 || fstat(fd, &st) != 0) {
+		if(errc != NULL) { *errc = RT_IO; }
+		RETURN(NULL);
+	}
+
+	if(!S_ISREG(st.st_mode) || st.st_size == 0) {
+		RETURN(text__read_anonymous(file, mode, psize, errc));
+	}
+
+	size_t const size = (size_t)st.st_size;
+	size_t const mapping_size = text__mapping_size(size);
+	int const prot = mode == MT_READONLY ? PROT_READ : PROT_READ | PROT_WRITE;
+
+	// reserves place for the terminating '\0' if the size is a multiple of the page
+	// size, the rest of the last page of the file is filled with zeros by the kernel
+	char* const text = (char*)mmap(NULL, mapping_size, prot, 
+								   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(text == MAP_FAILED) {
+		if(errc != NULL) { *errc = RT_MEMORY; }
+		RETURN(NULL);
+	}
+	if(mmap(text, size, prot, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		munmap(text, mapping_size);
+		if(errc != NULL) { *errc = RT_IO; }
+		RETURN(NULL);
+	}
+
+	madvise(text, size, MADV_SEQUENTIAL);
+	madvise(text, size, MADV_WILLNEED);
+
+	*psize = size;
+	if(errc != NULL) { *errc = RT_OK; }
+	RETURN(text);
+}
 
+char* const map_text2(char const* const fname, MT_mode_t const mode, size_t* const psize,
+					  RF_err_t* const errc)
+{$_
+	ASSERT(fname != NULL);
+	ASSERT(psize != NULL);
+
+	FILE* const ifile = fopen(fname, "rb");
+	if(ifile == NULL) {
+		if(errc != NULL) { *errc = RF_NOTFOUND; }
+		RETURN(NULL);
+	}
+
+	RT_err_t rt_errc = RT_OK;
+	char* const text = map_text(ifile, mode, psize, &rt_errc);
+
+	// the mapping stays valid after the file is closed
+	fclose(ifile);
+
+	if(errc != NULL) {
+		switch(rt_errc) {
+		case RT_OK:
+			*errc = RF_OK;
+			break;
+		case RT_IO:
+			*errc = RF_STDIO;
+			break;
+		case RT_MEMORY:
+			*errc = RF_MEMORY;
+			break;
+		}
+	}
+	RETURN(text);
+}
+
+void unmap_text(char* const text, size_t const size)
+{$_
+	if(text != NULL) {
+		munmap(text, text__mapping_size(size));
+	}
+$$
+}
+
+/*
+ * Output. Lines are copied into a large aligned buffer which is written by
+ * write() directly, bypassing stdio; lines longer than TEXT__WRITE_DIRECT are
+ * not copied but written together with the buffer by writev().
+ */
+#define TEXT__WRITE_BUFSIZE (1 << 20)
+#define TEXT__WRITE_DIRECT (64 << 10)
+
+static int const text__write_all(int const fd, struct iovec* iov, int iovcnt)
+{
+	while(iovcnt > 0) {
+		ssize_t n = writev(fd, iov, iovcnt);
+		if(n == -1) {
+			if(errno == EINTR) {
+				continue;
+			}
+			return 0;
+		}
+
+		// skips written parts
+		for(; iovcnt > 0 && (size_t)n >= iov->iov_len; ++iov, --iovcnt) {
+			n -= (ssize_t)iov->iov_len;
+		}
+		if(iovcnt > 0) {
+			iov->iov_base = (char*)iov->iov_base + n;
+			iov->iov_len -= (size_t)n;
+		}
+	}
+	return 1;
+}
+
+static int const text__write_lines_stdio(FILE* const file, strv_t const * const lines, 
+										  size_t const nlines) 
+{
 	for(size_t i = 0; i < nlines; ++i) {
 		size_t size = strv_len(&lines[i]);
 		if(fwrite(strv_begin(&lines[i]), sizeof(char), size, file) != size)
-			RETURN(0);
+			return 0;
 
 		if(fputc((int)'\n', file) == EOF)
-			RETURN(0);
+			return 0;
 	}
 
-	RETURN(1);
+	return 1;
+}
+
+int const write_lines(FILE* const file, strv_t const * const lines, 
+					   size_t const nlines) 
+{$_
+	ASSERT(file != NULL);
+	ASSERT(ferror(file) == 0);
+	ASSERT(lines != NULL);
+
+	int const fd = fileno(file);
+	char* buf = NULL;
+	if(fd == -1 || fflush(file) != 0 || 
+	   posix_memalign((void**)&buf, (size_t)sysconf(_SC_PAGESIZE), TEXT__WRITE_BUFSIZE) != 0) {
+		// streams without a descriptor (fmemopen) or no memory
+		RETURN(text__write_lines_stdio(file, lines, nlines));
+	}
+
+	size_t size = 0;
+	for(size_t i = 0; i < nlines; ++i) {
+		// fields are used directly, strv functions are too heavy for this loop
+		char const* const line = lines[i].pfirst;
+		size_t const len = (size_t)(lines[i].plast - lines[i].pfirst);
+
+		if(len >= TEXT__WRITE_DIRECT) {
+			struct iovec iov[2] = { { buf, size }, { (void*)line, len } };
+			if(!text__write_all(fd, iov, 2)) {
+				free(buf);
+				RETURN(0);
+			}
+			size = 0;
+		}
+		else {
+			if(size + len + 1 > TEXT__WRITE_BUFSIZE) {
+				struct iovec iov = { buf, size };
+				if(!text__write_all(fd, &iov, 1)) {
+					free(buf);
+					RETURN(0);
+				}
+				size = 0;
+			}
+			memcpy(buf + size, line, len);
+			size += len;
+		}
+		buf[size++] = '\n';
+	}
+
+	struct iovec iov = { buf, size };
+	int const ok = text__write_all(fd, &iov, 1);
+
+	free(buf);
+	RETURN(ok);
 }
 
 strv_t* const get_text_lines(char * const text, size_t const size, char const sep, 
@@ -113,20 +545,210 @@ strv_t* const get_text_lines(char * const text, size_t const size, char const se
 	ASSERT(text != NULL);
 	ASSERT(pnlines != NULL);
 
-	size_t const nlines = count_lines(text, size, sep);
-
-	strv_t* lines = (strv_t*)calloc(nlines, sizeof(strv_t));
+	// single pass: the output grows as the lines are found
+	size_t capacity = size / 64 + 2 * TEXT__BLOCK;
+	strv_t* lines = (strv_t*)malloc(capacity * sizeof(strv_t));
 	if(lines == NULL) {
 		RETURN(NULL);
 	}
 
-	size_t nlines_check = split_text(text, size, sep, lines);
-	ASSERT(nlines == nlines_check);
+	text__split_t split = { text, text, lines, lines, capacity };
+	for(;;) {
+		text__split_run(&split, text + size, sep);
+		if(split.ch == text + size) {
+			break;
+		}
+
+		size_t const nfound = (size_t)(split.curline - lines);
+		capacity *= 2;
+		strv_t* const new_lines = (strv_t*)realloc(lines, capacity * sizeof(strv_t));
+		if(new_lines == NULL) {
+			free(lines);
+			RETURN(NULL);
+		}
+
+		lines = new_lines;
+		split.lines = lines;
+		split.curline = lines + nfound;
+		split.capacity = capacity;
+	}
+
+	// place for the last line
+	size_t const nlines = (size_t)(split.curline - lines) + 1;
+	if(nlines > capacity) {
+		strv_t* const new_lines = (strv_t*)realloc(lines, nlines * sizeof(strv_t));
+		if(new_lines == NULL) {
+			free(lines);
+			RETURN(NULL);
+		}
+		lines = new_lines;
+	}
+	lines[nlines - 1] = strv_init(split.rover, text + size);
 
 	*pnlines = nlines;
 	RETURN(lines);
 }
 
+/*
+ * Parallel split. The text is divided into chunks of equal size, each chunk
+ * boundary is moved right after the nearest separator, so every line except the
+ * last one ends in its own chunk. Workers split their chunks into private
+ * arrays, then the counts are summed up and the workers copy their lines to
+ * their offsets in the result.
+ */
+#define TEXT__MT_MIN_CHUNK (1 << 20)
+
+typedef struct {
+	pthread_t thread;
+	int started;
+	char sep;
+	char const* begin;
+	char const* end;
+
+	strv_t* lines;
+	size_t nlines;
+	strv_t* dest;
+	int error;
+} text__worker_t;
+
+static void* text__worker_split(void* const data)
+{
+	text__worker_t* const worker = (text__worker_t*)data;
+
+	size_t capacity = (size_t)(worker->end - worker->begin) / 64 + 2 * TEXT__BLOCK;
+	strv_t* lines = (strv_t*)malloc(capacity * sizeof(strv_t));
+	if(lines == NULL) {
+		worker->error = 1;
+		return NULL;
+	}
+
+	text__split_t split = { worker->begin, worker->begin, lines, lines, capacity };
+	for(;;) {
+		text__split_run(&split, worker->end, worker->sep);
+		if(split.ch == worker->end) {
+			break;
+		}
+
+		size_t const nfound = (size_t)(split.curline - split.lines);
+		capacity *= 2;
+		strv_t* const new_lines = (strv_t*)realloc(split.lines, capacity * sizeof(strv_t));
+		if(new_lines == NULL) {
+			worker->error = 1;
+			break;
+		}
+
+		split.lines = new_lines;
+		split.curline = new_lines + nfound;
+		split.capacity = capacity;
+	}
+
+	worker->lines = split.lines;
+	worker->nlines = (size_t)(split.curline - split.lines);
+	return NULL;
+}
+
+static void* text__worker_copy(void* const data)
+{
+	text__worker_t* const worker = (text__worker_t*)data;
+	memcpy(worker->dest, worker->lines, worker->nlines * sizeof(strv_t));
+	return NULL;
+}
+
+// runs fn for every worker, the calling thread runs the first one and the ones
+// whose threads failed to start
+static void text__run_workers(text__worker_t* const workers, size_t const nworkers,
+							  void* (*fn)(void*))
+{
+	for(size_t i = 1; i < nworkers; ++i) {
+		workers[i].started = pthread_create(&workers[i].thread, NULL, fn, 
+											&workers[i]) == 0;
+	}
+	for(size_t i = 0; i < nworkers; ++i) {
+		if(i == 0 || !workers[i].started) {
+			fn(&workers[i]);
+		}
+	}
+	for(size_t i = 1; i < nworkers; ++i) {
+		if(workers[i].started) {
+			pthread_join(workers[i].thread, NULL);
+		}
+	}
+}
+
+strv_t* const get_text_lines_mt(char * const text, size_t const size, char const sep,
+								size_t* const pnlines, size_t nthreads)
+{$_
+	ASSERT(text != NULL);
+	ASSERT(pnlines != NULL);
+
+	if(nthreads == 0) {
+		long const ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = ncpus > 0 ? (size_t)ncpus : 1;
+	}
+	if(nthreads > size / TEXT__MT_MIN_CHUNK) {
+		nthreads = size / TEXT__MT_MIN_CHUNK;
+	}
+	if(nthreads <= 1) {
+		RETURN(get_text_lines(text, size, sep, pnlines));
+	}
+
+	text__worker_t* const workers = (text__worker_t*)calloc(nthreads, 
+															 sizeof(text__worker_t));
+	if(workers == NULL) {
+		RETURN(NULL);
+	}
+
+	char const* const end = text + size;
+	char const* begin = text;
+	for(size_t i = 0; i < nthreads; ++i) {
+		char const* chunk_end = end;
+		if(i + 1 < nthreads && begin < end) {
+			chunk_end = text + size / nthreads * (i + 1);
+			if(chunk_end < begin) {
+				chunk_end = begin;
+			}
+			chunk_end = (char const*)memchr(chunk_end, sep, (size_t)(end - chunk_end));
+			chunk_end = chunk_end == NULL ? end : chunk_end + 1;
+		}
+
+		workers[i].sep = sep;
+		workers[i].begin = begin;
+		workers[i].end = chunk_end;
+		begin = chunk_end;
+	}
+
+	// workers only read the selected implementation
+	text__init_simd();
+	text__run_workers(workers, nthreads, text__worker_split);
+
+	int error = 0;
+	size_t nlines = 1; // the last line
+	for(size_t i = 0; i < nthreads; ++i) {
+		error |= workers[i].error;
+		nlines += workers[i].nlines;
+	}
+
+	strv_t* lines = error ? NULL : (strv_t*)malloc(nlines * sizeof(strv_t));
+	if(lines != NULL) {
+		size_t offset = 0;
+		for(size_t i = 0; i < nthreads; ++i) {
+			workers[i].dest = lines + offset;
+			offset += workers[i].nlines;
+		}
+		text__run_workers(workers, nthreads, text__worker_copy);
+
+		lines[nlines - 1] = strv_init(nlines > 1 ? lines[nlines - 2].plast + 1 : text, 
+									  end);
+		*pnlines = nlines;
+	}
+
+	for(size_t i = 0; i < nthreads; ++i) {
+		free(workers[i].lines);
+	}
+	free(workers);
+	RETURN(lines);
+}
+
 char* const read_text2(char const* const fname, size_t* const psize, 
 						  RF_err_t* const errc)
 {$_
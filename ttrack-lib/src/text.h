@@ -72,6 +72,77 @@ char const * const RF_errstr(RF_err_t const errc);
  */
 char* const read_text2(char const* const fname, size_t* const psize, RF_err_t* const errc);
 
+/// Access modes for map_text() and map_text2().
+typedef enum {
+	MT_READONLY = 0, ///< Text can't be modified. Writing causes SIGSEGV.
+	MT_PRIVATE  = 1  ///< Copy-on-write: text can be modified, the file stays unchanged.
+} MT_mode_t;
+
+/**
+ * \brief Maps whole data of the stream to memory. Like read_text(), but the data isn't
+ * copied: pages are read from the page cache on the first access.
+ *
+ * Streams which can't be mapped (pipes, terminals) are read into anonymous memory.
+ * The data is always followed by '\0'.
+ *
+ * \param [in] file file with data to be mapped. Must be nonnull. Error indicator must
+ * 		be unset.
+ * \param [in] mode access mode of the returned data.
+ * \param [out] psize pointer to size of the data. Unmodified in case of any error.
+ * 		Must be nonnull.
+ * \param [out] errc error code (RT_OK if the function terminated successfully).
+ *		May be NULL.
+ *
+ * \return mapped data or NULL in case of any error.
+ *
+ * \warning You have to call unmap_text() (not free()) for the return value.
+ */
+char* const map_text(FILE* const file, MT_mode_t const mode, size_t* const psize, 
+					 RT_err_t* const errc);
+
+/**
+ * \brief Maps whole data of the file to memory. See map_text().
+ *
+ * \param[in] fname name of the file. Must be nonnull.
+ * \param[in] mode access mode of the returned data.
+ * \param[out] psize size of the data. Must be nonull.
+ * \param[out] errc error code (RF_OK if the function terminated successfully).
+ * 		May be NULL.
+ * \return mapped data or NULL in case of any error.
+ *
+ * \warning You have to call unmap_text() (not free()) for the return value.
+ */
+char* const map_text2(char const* const fname, MT_mode_t const mode, size_t* const psize,
+					  RF_err_t* const errc);
+
+/**
+ * \brief Releases data returned by map_text() or map_text2().
+ *
+ * \param[in] text pointer to the data. May be NULL.
+ * \param[in] size size of the data returned by map_text().
+ */
+void unmap_text(char* const text, size_t const size);
+
+/// Instruction sets for separator search in count_lines(), split_text() and
+/// get_text_lines().
+typedef enum {
+	TEXT_SIMD_AUTO   = 0, ///< The best one supported by the CPU.
+	TEXT_SIMD_SCALAR = 1, ///< Byte by byte.
+	TEXT_SIMD_SSE2   = 2, ///< 16 bytes per instruction.
+	TEXT_SIMD_AVX2   = 3  ///< 32 bytes per instruction.
+} text_simd_t;
+
+/**
+ * \brief Selects the instruction set for separator search. By default (or if it is 
+ * not called) the best one supported by the CPU is used. Must not be called while
+ * other threads split or count lines.
+ *
+ * \param[in] simd wanted instruction set. Unsupported ones are replaced by the best
+ * 		supported.
+ * \return the instruction set actually selected.
+ */
+text_simd_t const text_set_simd(text_simd_t simd);
+
 /**
  * \brief Splits text on array of separate lines.
  *
@@ -85,6 +156,22 @@ char* const read_text2(char const* const fname, size_t* const psize, RF_err_t* c
 strv_t* const get_text_lines(char * const text, size_t const size, char const sep, 
 							   size_t* const pnlines);
 
+/**
+ * \brief Splits text on array of separate lines using several threads. Returns the
+ * same array as get_text_lines().
+ *
+ * \param[in] text the text to be processed
+ * \param[in] size size of the text in bytes
+ * \param[out] pnlines number of lines. Unmodified if the function failed
+ * \param[in] nthreads number of threads, 0 for the number of processors. Small texts
+ * 		are split by fewer threads (at least 1 MB per thread).
+ * \return pointer to the lines or NULL if malloc() failed.
+ *
+ * \warning You have to call free() for the return value.
+ */
+strv_t* const get_text_lines_mt(char * const text, size_t const size, char const sep,
+								size_t* const pnlines, size_t nthreads);
+
 /**
  * \brief Count a number of lines in the text.
  *
@@ -112,6 +199,9 @@ size_t const split_text(char * const text, size_t const size, char const sep,
 /**
  * \brief Writes lines to file.
  *
+ * The stream is flushed, then the lines are written to its descriptor by large
+ * blocks, bypassing stdio.
+ *
  * \param[in] file handle of the file to write. Must be nonnull. Error indicator must
  * 		be unset.
  * \param[in] lines pointer to the lines array. Must be nonnull.